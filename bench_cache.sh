@@ -0,0 +1,31 @@
+#!/bin/sh
+#
+# Compare the wall time of a cold run, which parses the input as text and
+# fills the cache, with warm runs that load it from the cache, for a
+# generated tree. Usage: bench_cache.sh [keys] [leaves] [runs]
+
+keys=${1:-256}
+leaves=${2:-4096}
+runs=${3:-3}
+input=bench_cache.in
+cache=bench_cache.d
+
+awk -v k=$keys -v l=$leaves 'BEGIN {
+	for (i = 0; i < k; i++) {
+		printf "key%d {\n", i;
+		for (j = 0; j < l; j++) printf "  leaf%d = \"value%d\";\n", j, j;
+		printf "}\n";
+	}
+}' > $input
+
+rm -rf $cache
+for run in cold $(seq $runs); do
+	[ $run = cold ] || run="warm $run"
+	start=$(date +%s.%N)
+	./uclcmd get --cache=$cache -f $input .key0.leaf0 > /dev/null
+	end=$(date +%s.%N)
+	echo "$start $end" | awk '{
+		printf "run '"$run"': %.3fs\n", $2 - $1 }'
+done
+
+rm -rf $input $cache
@@ -0,0 +1,44 @@
+#!/bin/sh
+#
+# Measure JSON output throughput, in MB per second, for a generated tree of
+# strings that mix plain text with quotes, backslashes and control
+# characters, with each of the given --jobs counts.
+# Usage: bench_emit.sh [keys] [leaves] [runs] [jobs...]
+
+keys=${1:-16}
+leaves=${2:-16384}
+runs=${3:-3}
+threads=1
+if [ $# -gt 3 ]; then
+	shift 3
+	threads=$*
+fi
+input=bench_emit.in
+
+awk -v k=$keys -v l=$leaves 'BEGIN {
+	for (i = 0; i < k; i++) {
+		printf "key%d {\n", i;
+		for (j = 0; j < l; j++) {
+			printf "  leaf%d = \"path\\\\to\\\\file%d \\\"quoted\\\" ", j, j;
+			printf "line\\none\\ttab, and some plain text to copy\";\n";
+		}
+		printf "}\n";
+	}
+}' > $input
+
+for mode in -j -c; do
+	bytes=$(./uclcmd get $mode . < $input | wc -c)
+	for p in $threads; do
+		for run in $(seq $runs); do
+			start=$(date +%s.%N)
+			./uclcmd get -P $p $mode . < $input > /dev/null
+			end=$(date +%s.%N)
+			echo "$bytes $start $end" | awk '{
+				printf "'$mode' -P '$p' run %d: %d bytes in %.3fs, " \
+				    "%.1f MB/s\n", '$run', $1, $3 - $2,
+				    $1 / ($3 - $2) / 1048576 }'
+		done
+	done
+done
+
+rm -f $input
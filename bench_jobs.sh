@@ -0,0 +1,28 @@
+#!/bin/sh
+#
+# Time get --jobs against the serial run on a generated wide tree, and check
+# that every run produces the same output. Usage: bench_jobs.sh [keys] [leaves]
+
+keys=${1:-256}
+leaves=${2:-4096}
+input=bench_jobs.in
+
+awk -v k=$keys -v l=$leaves 'BEGIN {
+	for (i = 0; i < k; i++) {
+		printf "key%d {\n", i;
+		for (j = 0; j < l; j++) printf "  leaf%d = \"value %d\";\n", j, j;
+		printf "}\n";
+	}
+}' > $input
+
+./uclcmd get -k '.|recurse' < $input | cksum > bench_jobs.sum
+for jobs in 1 2 4 8 16; do
+	echo "jobs=$jobs"
+	/usr/bin/time -p ./uclcmd get -P $jobs -k '.|recurse' < $input \
+	    > bench_jobs.out
+	if [ "$(cksum < bench_jobs.out)" != "$(cat bench_jobs.sum)" ]; then
+		echo "jobs=$jobs: output differs from the serial run"
+	fi
+done
+
+rm -f $input bench_jobs.out bench_jobs.sum
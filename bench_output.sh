@@ -0,0 +1,29 @@
+#!/bin/sh
+#
+# Measure output throughput, in lines per second, for the shell variable
+# dump of a generated tree. Usage: bench_output.sh [keys] [leaves] [runs]
+
+keys=${1:-256}
+leaves=${2:-4096}
+runs=${3:-3}
+input=bench_output.in
+
+awk -v k=$keys -v l=$leaves 'BEGIN {
+	for (i = 0; i < k; i++) {
+		printf "key%d {\n", i;
+		for (j = 0; j < l; j++) printf "  leaf%d = %d;\n", j, j;
+		printf "}\n";
+	}
+}' > $input
+
+lines=$(./uclcmd get --keys --shellvars '.|recurse' < $input | wc -l)
+for run in $(seq $runs); do
+	start=$(date +%s.%N)
+	./uclcmd get --keys --shellvars '.|recurse' < $input > /dev/null
+	end=$(date +%s.%N)
+	echo "$lines $start $end" | awk '{
+		printf "run %d: %d lines in %.3fs, %.0f lines/s\n", '$run',
+		    $1, $3 - $2, $1 / ($3 - $2) }'
+done
+
+rm -f $input
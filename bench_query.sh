@@ -0,0 +1,124 @@
+#!/bin/sh
+#
+# Measure wall time and heap allocations for '.|each|.name' over an array of
+# generated objects. Allocations are counted by a small malloc wrapper that
+# is built here and preloaded. Pass the path of another build to compare.
+# Usage: bench_query.sh [elements] [runs] [uclcmd]
+
+elements=${1:-100000}
+runs=${2:-3}
+uclcmd=${3:-./uclcmd}
+input=bench_query.in
+counter=bench_query_alloc
+
+awk -v n=$elements 'BEGIN {
+	print "[";
+	for (i = 0; i < n; i++) printf "  { name = \"name%d\"; id = %d; },\n", i, i;
+	print "]";
+}' > $input
+
+cat > $counter.c <<'EOC'
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static void *(*real_malloc)(size_t);
+static void *(*real_calloc)(size_t, size_t);
+static void *(*real_realloc)(void *, size_t);
+static void (*real_free)(void *);
+static unsigned long allocs;
+static char boot[8192];
+static size_t bootlen;
+static int booting;
+
+static void
+init(void)
+{
+    booting = 1;
+    real_malloc = dlsym(RTLD_NEXT, "malloc");
+    real_calloc = dlsym(RTLD_NEXT, "calloc");
+    real_realloc = dlsym(RTLD_NEXT, "realloc");
+    real_free = dlsym(RTLD_NEXT, "free");
+    booting = 0;
+}
+
+/* dlsym() may allocate before the real functions are known */
+static void *
+boot_alloc(size_t n)
+{
+    void *p = boot + bootlen;
+
+    bootlen += (n + 15) & ~(size_t)15;
+    return (bootlen <= sizeof(boot) ? p : NULL);
+}
+
+void *
+malloc(size_t n)
+{
+    if (booting)
+	return (boot_alloc(n));
+    if (real_malloc == NULL)
+	init();
+    allocs++;
+    return (real_malloc(n));
+}
+
+void *
+calloc(size_t c, size_t n)
+{
+    if (booting)
+	return (boot_alloc(c * n));
+    if (real_calloc == NULL)
+	init();
+    allocs++;
+    return (real_calloc(c, n));
+}
+
+void *
+realloc(void *p, size_t n)
+{
+    if (real_realloc == NULL)
+	init();
+    allocs++;
+    return (real_realloc(p, n));
+}
+
+void
+free(void *p)
+{
+    if ((char *)p >= boot && (char *)p < boot + sizeof(boot))
+	return;
+    if (real_free == NULL)
+	init();
+    real_free(p);
+}
+
+static void __attribute__((destructor))
+report(void)
+{
+    char buf[64];
+    int len;
+
+    len = snprintf(buf, sizeof(buf), "allocations: %lu\n", allocs);
+    write(2, buf, len);
+}
+EOC
+# dlsym() is in libc on some systems and in libdl on others
+cc -shared -fPIC -O2 -o $counter.so $counter.c -ldl 2> /dev/null ||
+    cc -shared -fPIC -O2 -o $counter.so $counter.c || exit 1
+
+allocs=$(LD_PRELOAD=./$counter.so $uclcmd get -f $input '.|each|.name' \
+    2>&1 > /dev/null | awk '/^allocations:/ { print $2 }')
+echo "$elements elements, $allocs allocations"
+for run in $(seq $runs); do
+	start=$(date +%s.%N)
+	$uclcmd get -f $input '.|each|.name' > /dev/null
+	end=$(date +%s.%N)
+	echo "$elements $start $end" | awk '{
+		printf "run %d: %d elements in %.3fs, %.0f elements/s\n", '$run',
+		    $1, $3 - $2, $1 / ($3 - $2) }'
+done
+
+rm -f $input $counter.c $counter.so
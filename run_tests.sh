@@ -1,15 +1,87 @@
 #!/bin/sh
 
 fail=0
+
+# Traversal stress test input, nested just under libucl's 65535 level limit.
+# Generated rather than kept in git.
+depth=65000
+if [ ! -f tests/deep.in ]; then
+	awk -v d=$depth 'BEGIN { for (i = 0; i < d; i++) printf "[";
+	    printf "1"; for (i = 0; i < d; i++) printf "]"; printf "\n" }' \
+	    > tests/deep.in
+	awk -v d=$depth 'BEGIN { for (i = 1; i < d; i++) print "[array]";
+	    print "1" }' > tests/deep_01.res
+fi
+
+# Output stress test input, more than the 64 KiB output buffer holds and
+# more elements than -P splits JSON output at.
+# Generated rather than kept in git.
+width=10000
+if [ ! -f tests/wide.in ]; then
+	awk -v w=$width 'BEGIN { print "list [";
+	    for (i = 0; i < w; i++) printf "    \"value-%05d\",\n", i;
+	    print "]" }' > tests/wide.in
+	awk -v w=$width 'BEGIN { for (i = 0; i < w; i++)
+	    printf "\"value-%05d\"\n", i }' > tests/wide_01.res
+	cp tests/wide_01.res tests/wide_02.res
+	{ cat tests/wide.in; echo; } > tests/wide_03.res
+	awk -v w=$width 'BEGIN { print "list: [";
+	    for (i = 0; i < w; i++) printf "%s    \"value-%05d\"",
+	    i ? ",\n" : "", i; print "\n]" }' > tests/wide_04.res
+	awk -v w=$width 'BEGIN { s = "[";
+	    for (i = 0; i < w; i++) s = s sprintf("%s\"value-%05d\"",
+	    i ? "," : "", i); s = s "]"; printf "%d:%s,", length(s), s }' \
+	    > tests/wide_07.res
+	awk -v w=$width 'BEGIN { for (i = 0; i < w; i++)
+	    printf "11:value-%05d,", i }' > tests/wide_08.res
+fi
+
+# Parallel UCL output test input, a top level object wide enough for -P to
+# split, of objects and arrays that have to be indented to fit.
+# Generated rather than kept in git.
+if [ ! -f tests/wideobj.in ]; then
+	awk -v w=$width 'BEGIN { for (i = 0; i < w; i++)
+	    printf "key%05d { n = %d; l [%d, { a = \"x\"; }]; }\n", i, i, i }' \
+	    > tests/wideobj.in
+fi
+
+# Cache tests expect to start cold
+rm -rf tests/.cache
+
 for test_in in tests/*.in; do
 	for test_cmd in tests/$(basename ${test_in} .in)_*.cmd; do
-		cat $test_in | ./uclcmd $(cat $test_cmd) > test.out
+		cat $test_in | ./uclcmd $(cat $test_cmd) > test.out 2> test.err
 		e=$?
+		# A .err file holds a pattern the test's stderr must match
+		err=tests/$(basename $test_cmd .cmd).err
+		if [ -f $err ]; then
+			if ! grep -q -f $err test.err; then
+				echo Test[$(basename $test_cmd .cmd)] Failed. \
+				    stderr did not match $(cat $err).
+				fail=$(( $fail + 1 ))
+				continue
+			fi
+		else
+			cat test.err >&2
+		fi
+		# A .status file holds the exit status the test expects
+		status=tests/$(basename $test_cmd .cmd).status
+		if [ -f $status ]; then
+			e=$(( $e != $(cat $status) ))
+		fi
 		if [ $e -gt 0 ]; then
 			echo Test[$(basename $test_cmd .cmd)] Failed. Error.
 			fail=$(( $fail + 1 ))
 		else
-			res=$(diff -u tests/$(basename $test_cmd .cmd).res test.out)
+			# A .ref file holds a command whose output must be matched,
+			# in place of a .res
+			expect=tests/$(basename $test_cmd .cmd).res
+			ref=tests/$(basename $test_cmd .cmd).ref
+			if [ -f $ref ]; then
+				cat $test_in | ./uclcmd $(cat $ref) > test.ref
+				expect=test.ref
+			fi
+			res=$(diff -u $expect test.out)
 			if [ $? -gt 0 ]; then
 				echo Test[$(basename $test_cmd .cmd)] Failed. did not match.
 				echo "$res"
@@ -0,0 +1 @@
+get -k disks|each|group_by(.pool)|sum(.size)
@@ -0,0 +1,3 @@
+disks.zroot=1000
+disks.tank=16000
+disks.null=2
@@ -0,0 +1 @@
+get disks|each|.pool|distinct
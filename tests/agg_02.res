@@ -0,0 +1,3 @@
+"zroot"
+"tank"
+
@@ -0,0 +1 @@
+get -k disks|each|max(.size)
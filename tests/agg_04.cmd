@@ -0,0 +1 @@
+get -k disks|each|count(.pool)
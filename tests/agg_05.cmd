@@ -0,0 +1 @@
+get -c tags|each|distinct
@@ -0,0 +1,2 @@
+"a\u0000b"
+"a\u0000c"
@@ -0,0 +1 @@
+get --cache=tests/.cache -f tests/cache.in .timeout|type
@@ -0,0 +1 @@
+time
@@ -0,0 +1 @@
+get -d --cache=tests/.cache -f tests/cache.in .timeout|type
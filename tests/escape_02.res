@@ -0,0 +1 @@
+{"quote0":"\"aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa","quote15":"aaaaaaaaaaaaaaa\"aaaaaaaaaaaaaaaa","bslash16":"aaaaaaaaaaaaaaaa\\aaaaaaaaaaaaaaa","ctrl17":"aaaaaaaaaaaaaaaaa\u0001aaaaaaaaaaaaaa","tab31":"aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa\taaa","newline32":"aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa\n","mixed":"\b\f\r\u001F\"\\/","utf8":"aaaaaaaaaaaaaaé€aaaaaaaaaaaaaaaaaa","short":"é\"\u0002","empty":"","emptyobj":{},"emptyarr":[],"nested":{"inner":{},"list":[[],{}]}}
@@ -0,0 +1 @@
+get --export .
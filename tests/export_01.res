@@ -0,0 +1,11 @@
+__keys='net'
+net='{object}'
+net__keys='hostname motd ports ipv6_enabled'
+net_hostname='it'\''s a "test" box'
+net_motd='line one
+line two'
+net_ports='[array]'
+net_ports__length='2'
+net_ports_0='22'
+net_ports_1='80'
+net_ipv6_enabled='true'
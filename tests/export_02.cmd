@@ -0,0 +1 @@
+get --export=cfg net.ports
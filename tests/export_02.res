@@ -0,0 +1,4 @@
+cfg_net_ports='[array]'
+cfg_net_ports__length='2'
+cfg_net_ports_0='22'
+cfg_net_ports_1='80'
@@ -0,0 +1 @@
+get --export=1-x net.ports
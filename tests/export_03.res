@@ -0,0 +1,4 @@
+_1_x_net_ports='[array]'
+_1_x_net_ports__length='2'
+_1_x_net_ports_0='22'
+_1_x_net_ports_1='80'
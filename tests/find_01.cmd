@@ -0,0 +1 @@
+find 10.0.3.7
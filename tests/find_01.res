@@ -0,0 +1,3 @@
+hosts.web1.addr
+hosts.web1.aliases.1
+firewall.allow.0
@@ -0,0 +1 @@
+find -g 10.0.3.?
@@ -0,0 +1,3 @@
+hosts.web1.addr
+hosts.db1.addr
+firewall.allow.0
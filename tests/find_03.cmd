@@ -0,0 +1 @@
+find -K -E ^(web|db)1$
@@ -0,0 +1,2 @@
+hosts.web1
+hosts.db1
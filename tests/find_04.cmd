@@ -0,0 +1 @@
+find -P 4 -k 10.0.3
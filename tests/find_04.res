@@ -0,0 +1,4 @@
+hosts.web1.addr="10.0.3.7"
+hosts.web1.aliases.1="10.0.3.7/24"
+hosts.db1.addr="10.0.3.9"
+firewall.allow.0="10.0.3.7"
@@ -0,0 +1 @@
+find -V -g 0.500000
@@ -0,0 +1 @@
+firewall.weight
@@ -0,0 +1 @@
+{"big":100000000000000000000.0,"huge":-3000000000000000157514280765613260746113405743324477464747562346535407373966724587359114125241343592131113331498651634530827569706081291726934376554360120948545161602779727411213490701384364270178106859704912399835243357116902922640223958228340427483737776366460170528514347008416589160596378201620480.0,"pi":3.141592653589793,"tiny":1e-09,"half":0.500000,"third":0.3333333333333333}
@@ -0,0 +1 @@
+get -f tests/get.in rootkey.subkey.child
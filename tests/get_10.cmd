@@ -0,0 +1 @@
+get -d --cache=tests/.cache -f tests/get.in rootkey.array.2
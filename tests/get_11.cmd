@@ -0,0 +1 @@
+get --explain rootkey.array|each|.key|length
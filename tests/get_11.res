@@ -0,0 +1,5 @@
+query: rootkey.array|each|.key|length
+  node: rootkey.array [rootkey, array]
+  1: each
+  2: path .key [key]
+  3: length
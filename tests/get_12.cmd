@@ -0,0 +1 @@
+get -k rootkey.subkey.child rootkey.array.1 rootkey.subkey rootkey.array.1
@@ -0,0 +1,4 @@
+rootkey.subkey.child="value"
+rootkey.array.1="b"
+rootkey.subkey={object}
+rootkey.array.1="b"
@@ -0,0 +1 @@
+get -k rootkey|each|each
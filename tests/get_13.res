@@ -0,0 +1,5 @@
+rootkey.subkey.key="value"
+rootkey.subkey.child="value"
+rootkey.array.0="a"
+rootkey.array.1="b"
+rootkey.array.2="c"
@@ -0,0 +1 @@
+rootkey.subkey={object}
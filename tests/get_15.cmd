@@ -0,0 +1 @@
+get rootkey|each|.key|any
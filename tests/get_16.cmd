@@ -0,0 +1 @@
+get rootkey.subkey.key|exists
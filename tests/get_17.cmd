@@ -0,0 +1 @@
+get rootkey.array|keys
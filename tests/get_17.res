@@ -0,0 +1,3 @@
+(null)
+(null)
+(null)
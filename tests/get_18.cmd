@@ -0,0 +1 @@
+get -k rootkey.**.key rootkey.array.[12]
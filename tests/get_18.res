@@ -0,0 +1,3 @@
+rootkey.subkey.key="value"
+rootkey.array.1="b"
+rootkey.array.2="c"
@@ -0,0 +1 @@
+get x[0]
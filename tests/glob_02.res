@@ -0,0 +1,2 @@
+x1=6
+x2=7
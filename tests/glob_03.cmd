@@ -0,0 +1 @@
+get -k **.a.**
@@ -0,0 +1,3 @@
+a={object}
+a.a={object}
+a.a.b=1
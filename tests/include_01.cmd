@@ -0,0 +1 @@
+get .list.1
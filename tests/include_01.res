@@ -0,0 +1 @@
+"beta"
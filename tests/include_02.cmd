@@ -0,0 +1 @@
+get -f tests/include.in .name
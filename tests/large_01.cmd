@@ -0,0 +1 @@
+get .key255
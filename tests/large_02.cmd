@@ -0,0 +1 @@
+get -e -k .|recurse
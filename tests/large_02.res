@@ -0,0 +1,257 @@
+._keys="key000 key001 key002 key003 key004 key005 key006 key007 key008 key009 key010 key011 key012 key013 key014 key015 key016 key017 key018 key019 key020 key021 key022 key023 key024 key025 key026 key027 key028 key029 key030 key031 key032 key033 key034 key035 key036 key037 key038 key039 key040 key041 key042 key043 key044 key045 key046 key047 key048 key049 key050 key051 key052 key053 key054 key055 key056 key057 key058 key059 key060 key061 key062 key063 key064 key065 key066 key067 key068 key069 key070 key071 key072 key073 key074 key075 key076 key077 key078 key079 key080 key081 key082 key083 key084 key085 key086 key087 key088 key089 key090 key091 key092 key093 key094 key095 key096 key097 key098 key099 key100 key101 key102 key103 key104 key105 key106 key107 key108 key109 key110 key111 key112 key113 key114 key115 key116 key117 key118 key119 key120 key121 key122 key123 key124 key125 key126 key127 key128 key129 key130 key131 key132 key133 key134 key135 key136 key137 key138 key139 key140 key141 key142 key143 key144 key145 key146 key147 key148 key149 key150 key151 key152 key153 key154 key155 key156 key157 key158 key159 key160 key161 key162 key163 key164 key165 key166 key167 key168 key169 key170 key171 key172 key173 key174 key175 key176 key177 key178 key179 key180 key181 key182 key183 key184 key185 key186 key187 key188 key189 key190 key191 key192 key193 key194 key195 key196 key197 key198 key199 key200 key201 key202 key203 key204 key205 key206 key207 key208 key209 key210 key211 key212 key213 key214 key215 key216 key217 key218 key219 key220 key221 key222 key223 key224 key225 key226 key227 key228 key229 key230 key231 key232 key233 key234 key235 key236 key237 key238 key239 key240 key241 key242 key243 key244 key245 key246 key247 key248 key249 key250 key251 key252 key253 key254 key255"
+key000="value 000 .............................."
+key001="value 001 .............................."
+key002="value 002 .............................."
+key003="value 003 .............................."
+key004="value 004 .............................."
+key005="value 005 .............................."
+key006="value 006 .............................."
+key007="value 007 .............................."
+key008="value 008 .............................."
+key009="value 009 .............................."
+key010="value 010 .............................."
+key011="value 011 .............................."
+key012="value 012 .............................."
+key013="value 013 .............................."
+key014="value 014 .............................."
+key015="value 015 .............................."
+key016="value 016 .............................."
+key017="value 017 .............................."
+key018="value 018 .............................."
+key019="value 019 .............................."
+key020="value 020 .............................."
+key021="value 021 .............................."
+key022="value 022 .............................."
+key023="value 023 .............................."
+key024="value 024 .............................."
+key025="value 025 .............................."
+key026="value 026 .............................."
+key027="value 027 .............................."
+key028="value 028 .............................."
+key029="value 029 .............................."
+key030="value 030 .............................."
+key031="value 031 .............................."
+key032="value 032 .............................."
+key033="value 033 .............................."
+key034="value 034 .............................."
+key035="value 035 .............................."
+key036="value 036 .............................."
+key037="value 037 .............................."
+key038="value 038 .............................."
+key039="value 039 .............................."
+key040="value 040 .............................."
+key041="value 041 .............................."
+key042="value 042 .............................."
+key043="value 043 .............................."
+key044="value 044 .............................."
+key045="value 045 .............................."
+key046="value 046 .............................."
+key047="value 047 .............................."
+key048="value 048 .............................."
+key049="value 049 .............................."
+key050="value 050 .............................."
+key051="value 051 .............................."
+key052="value 052 .............................."
+key053="value 053 .............................."
+key054="value 054 .............................."
+key055="value 055 .............................."
+key056="value 056 .............................."
+key057="value 057 .............................."
+key058="value 058 .............................."
+key059="value 059 .............................."
+key060="value 060 .............................."
+key061="value 061 .............................."
+key062="value 062 .............................."
+key063="value 063 .............................."
+key064="value 064 .............................."
+key065="value 065 .............................."
+key066="value 066 .............................."
+key067="value 067 .............................."
+key068="value 068 .............................."
+key069="value 069 .............................."
+key070="value 070 .............................."
+key071="value 071 .............................."
+key072="value 072 .............................."
+key073="value 073 .............................."
+key074="value 074 .............................."
+key075="value 075 .............................."
+key076="value 076 .............................."
+key077="value 077 .............................."
+key078="value 078 .............................."
+key079="value 079 .............................."
+key080="value 080 .............................."
+key081="value 081 .............................."
+key082="value 082 .............................."
+key083="value 083 .............................."
+key084="value 084 .............................."
+key085="value 085 .............................."
+key086="value 086 .............................."
+key087="value 087 .............................."
+key088="value 088 .............................."
+key089="value 089 .............................."
+key090="value 090 .............................."
+key091="value 091 .............................."
+key092="value 092 .............................."
+key093="value 093 .............................."
+key094="value 094 .............................."
+key095="value 095 .............................."
+key096="value 096 .............................."
+key097="value 097 .............................."
+key098="value 098 .............................."
+key099="value 099 .............................."
+key100="value 100 .............................."
+key101="value 101 .............................."
+key102="value 102 .............................."
+key103="value 103 .............................."
+key104="value 104 .............................."
+key105="value 105 .............................."
+key106="value 106 .............................."
+key107="value 107 .............................."
+key108="value 108 .............................."
+key109="value 109 .............................."
+key110="value 110 .............................."
+key111="value 111 .............................."
+key112="value 112 .............................."
+key113="value 113 .............................."
+key114="value 114 .............................."
+key115="value 115 .............................."
+key116="value 116 .............................."
+key117="value 117 .............................."
+key118="value 118 .............................."
+key119="value 119 .............................."
+key120="value 120 .............................."
+key121="value 121 .............................."
+key122="value 122 .............................."
+key123="value 123 .............................."
+key124="value 124 .............................."
+key125="value 125 .............................."
+key126="value 126 .............................."
+key127="value 127 .............................."
+key128="value 128 .............................."
+key129="value 129 .............................."
+key130="value 130 .............................."
+key131="value 131 .............................."
+key132="value 132 .............................."
+key133="value 133 .............................."
+key134="value 134 .............................."
+key135="value 135 .............................."
+key136="value 136 .............................."
+key137="value 137 .............................."
+key138="value 138 .............................."
+key139="value 139 .............................."
+key140="value 140 .............................."
+key141="value 141 .............................."
+key142="value 142 .............................."
+key143="value 143 .............................."
+key144="value 144 .............................."
+key145="value 145 .............................."
+key146="value 146 .............................."
+key147="value 147 .............................."
+key148="value 148 .............................."
+key149="value 149 .............................."
+key150="value 150 .............................."
+key151="value 151 .............................."
+key152="value 152 .............................."
+key153="value 153 .............................."
+key154="value 154 .............................."
+key155="value 155 .............................."
+key156="value 156 .............................."
+key157="value 157 .............................."
+key158="value 158 .............................."
+key159="value 159 .............................."
+key160="value 160 .............................."
+key161="value 161 .............................."
+key162="value 162 .............................."
+key163="value 163 .............................."
+key164="value 164 .............................."
+key165="value 165 .............................."
+key166="value 166 .............................."
+key167="value 167 .............................."
+key168="value 168 .............................."
+key169="value 169 .............................."
+key170="value 170 .............................."
+key171="value 171 .............................."
+key172="value 172 .............................."
+key173="value 173 .............................."
+key174="value 174 .............................."
+key175="value 175 .............................."
+key176="value 176 .............................."
+key177="value 177 .............................."
+key178="value 178 .............................."
+key179="value 179 .............................."
+key180="value 180 .............................."
+key181="value 181 .............................."
+key182="value 182 .............................."
+key183="value 183 .............................."
+key184="value 184 .............................."
+key185="value 185 .............................."
+key186="value 186 .............................."
+key187="value 187 .............................."
+key188="value 188 .............................."
+key189="value 189 .............................."
+key190="value 190 .............................."
+key191="value 191 .............................."
+key192="value 192 .............................."
+key193="value 193 .............................."
+key194="value 194 .............................."
+key195="value 195 .............................."
+key196="value 196 .............................."
+key197="value 197 .............................."
+key198="value 198 .............................."
+key199="value 199 .............................."
+key200="value 200 .............................."
+key201="value 201 .............................."
+key202="value 202 .............................."
+key203="value 203 .............................."
+key204="value 204 .............................."
+key205="value 205 .............................."
+key206="value 206 .............................."
+key207="value 207 .............................."
+key208="value 208 .............................."
+key209="value 209 .............................."
+key210="value 210 .............................."
+key211="value 211 .............................."
+key212="value 212 .............................."
+key213="value 213 .............................."
+key214="value 214 .............................."
+key215="value 215 .............................."
+key216="value 216 .............................."
+key217="value 217 .............................."
+key218="value 218 .............................."
+key219="value 219 .............................."
+key220="value 220 .............................."
+key221="value 221 .............................."
+key222="value 222 .............................."
+key223="value 223 .............................."
+key224="value 224 .............................."
+key225="value 225 .............................."
+key226="value 226 .............................."
+key227="value 227 .............................."
+key228="value 228 .............................."
+key229="value 229 .............................."
+key230="value 230 .............................."
+key231="value 231 .............................."
+key232="value 232 .............................."
+key233="value 233 .............................."
+key234="value 234 .............................."
+key235="value 235 .............................."
+key236="value 236 .............................."
+key237="value 237 .............................."
+key238="value 238 .............................."
+key239="value 239 .............................."
+key240="value 240 .............................."
+key241="value 241 .............................."
+key242="value 242 .............................."
+key243="value 243 .............................."
+key244="value 244 .............................."
+key245="value 245 .............................."
+key246="value 246 .............................."
+key247="value 247 .............................."
+key248="value 248 .............................."
+key249="value 249 .............................."
+key250="value 250 .............................."
+key251="value 251 .............................."
+key252="value 252 .............................."
+key253="value 253 .............................."
+key254="value 254 .............................."
+key255="value 255 .............................."
@@ -0,0 +1 @@
+get -P 4 -e -k .|recurse
@@ -0,0 +1 @@
+get --ndjson .|recurse
@@ -0,0 +1,8 @@
+{"path":"motd","value":"line one\nline two"}
+{"path":"users","value":[{"name":"root","shell":"/bin/sh"},{"name":"toor","shell":"/bin/csh"}]}
+{"path":"users.0","value":{"name":"root","shell":"/bin/sh"}}
+{"path":"users.0.name","value":"root"}
+{"path":"users.0.shell","value":"/bin/sh"}
+{"path":"users.1","value":{"name":"toor","shell":"/bin/csh"}}
+{"path":"users.1.name","value":"toor"}
+{"path":"users.1.shell","value":"/bin/csh"}
@@ -0,0 +1 @@
+get --ndjson users|each|.name
@@ -0,0 +1,2 @@
+{"path":"users.0.name","value":"root"}
+{"path":"users.1.name","value":"toor"}
@@ -0,0 +1 @@
+get --out cjson=- .disks
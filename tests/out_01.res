@@ -0,0 +1 @@
+[{"path":"/dev/ada0","size":20},{"path":"/dev/ada1","size":40}]
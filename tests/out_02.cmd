@@ -0,0 +1 @@
+get --out shellvars=- .disks|each|.path
@@ -0,0 +1,2 @@
+disks_0_path="/dev/ada0"
+disks_1_path="/dev/ada1"
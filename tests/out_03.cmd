@@ -0,0 +1 @@
+get --out export=/dev/null --out json=- .disks
@@ -0,0 +1 @@
+get --out json=/dev/null --out export=- .disks
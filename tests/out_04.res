@@ -0,0 +1,10 @@
+disks='[array]'
+disks__length='2'
+disks_0='{object}'
+disks_0__keys='path size'
+disks_0_path='/dev/ada0'
+disks_0_size='20'
+disks_1='{object}'
+disks_1__keys='path size'
+disks_1_path='/dev/ada1'
+disks_1_size='40'
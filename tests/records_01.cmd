@@ -0,0 +1 @@
+get --netstring -k .|recurse
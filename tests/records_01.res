@@ -0,0 +1,2 @@
+22:motd=line one
+line two,13:users=[array],16:users.0={object},17:users.0.name=root,21:users.0.shell=/bin/sh,16:users.1={object},17:users.1.name=toor,22:users.1.shell=/bin/csh,
\ No newline at end of file
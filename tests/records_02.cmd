@@ -0,0 +1 @@
+get --netstring -c users|each
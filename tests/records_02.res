@@ -0,0 +1 @@
+33:{"name":"root","shell":"/bin/sh"},34:{"name":"toor","shell":"/bin/csh"},
\ No newline at end of file
@@ -0,0 +1 @@
+get -P 2 -l -k .top|recurse
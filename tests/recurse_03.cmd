@@ -0,0 +1 @@
+get -d -P 2 -k .|recurse
@@ -0,0 +1 @@
+remove -c top.sub.a top.sub.inner.x top.sub.inner top.sub.b
@@ -0,0 +1 @@
+{"top":{"sub":{},"list":[{"k":1},{"k":2},{"k":3}]}}
@@ -0,0 +1 @@
+remove -c top.list.0.k top.list.0 top.list.0.k top.list.9
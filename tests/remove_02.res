@@ -0,0 +1 @@
+{"top":{"sub":{"a":1,"b":2,"inner":{"x":1,"y":2}},"list":[{},{"k":3}]}}
@@ -0,0 +1 @@
+remove -c top.list.*.k top.sub.inner.?
@@ -0,0 +1 @@
+{"top":{"sub":{"a":1,"b":2,"inner":{}},"list":[{},{},{}]}}
@@ -0,0 +1 @@
+get -k vms|each|select(.memory>4096)|.name
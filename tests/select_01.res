@@ -0,0 +1,2 @@
+vms.web1.name="web1"
+vms.db1.name="db1"
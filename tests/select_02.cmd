@@ -0,0 +1 @@
+get -k vms|each|select(.name=~^web)|select(.on!=true)|.memory
@@ -0,0 +1 @@
+vms.web2.memory=2048
@@ -0,0 +1 @@
+set -c rootkey.*.key new
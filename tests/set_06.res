@@ -0,0 +1 @@
+{"rootkey":{"subkey":{"key":"new","child":"value"},"array":["a","b","c"]}}
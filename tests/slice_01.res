@@ -0,0 +1 @@
+log.-1="halt"
@@ -0,0 +1 @@
+get -k log.::-3
@@ -0,0 +1,4 @@
+log.9="halt"
+log.6="sudo"
+log.3="sshd"
+log.0="boot"
@@ -0,0 +1 @@
+get -k vm.disk|slice(::2)|.path
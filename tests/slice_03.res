@@ -0,0 +1,2 @@
+vm.disk.0.path="/a"
+vm.disk.2.path="/c"
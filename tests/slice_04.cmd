@@ -0,0 +1 @@
+remove -c log.0:8:2
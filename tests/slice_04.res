@@ -0,0 +1 @@
+{"log":["mount","sshd","login","logout","shutdown","halt"],"vm":{"disk":[{"path":"/a"},{"path":"/b"},{"path":"/c"}]}}
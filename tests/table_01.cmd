@@ -0,0 +1 @@
+get hosts|table(.name,.ip,.cpus,.note)
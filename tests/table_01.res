@@ -0,0 +1,3 @@
+web1	10.0.0.1	4	plain
+db, primary	10.0.0.2	16	say "hi"\tnow
+spare		2	
@@ -0,0 +1 @@
+get --csv -k hosts|table(.name,.ip,.cpus,.note,.up)
@@ -0,0 +1,4 @@
+name,ip,cpus,note,up
+web1,10.0.0.1,4,plain,
+"db, primary",10.0.0.2,16,"say ""hi""	now",
+spare,,2,,false
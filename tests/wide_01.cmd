@@ -0,0 +1 @@
+get list|each
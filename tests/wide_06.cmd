@@ -0,0 +1 @@
+get -P 4 -c .
@@ -0,0 +1 @@
+get --netstring -c list
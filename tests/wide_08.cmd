@@ -0,0 +1 @@
+get --netstring list|each
@@ -0,0 +1 @@
+get -d -P 4 -u .
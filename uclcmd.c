@@ -34,9 +34,12 @@
  * Does ucl_object_insert_key_common need to respect NO_IMPLICIT_ARRAY
  */
 
-int debug = 0, expand = 0, mode = 0, nonewline = 0, show_keys = 0, show_raw = 0;
+int csv = 0, debug = 0, expand = 0, explain = 0, jobs = 1, mode = 0, nonewline = 0, show_keys = 0, show_raw = 0;
 bool firstline = true, shvars = false;
 int output_type = 254;
+int records = RECORDS_TEXT;
+__thread arena_t scratch;
+__thread FILE *outfp = NULL;
 ucl_object_t *root_obj = NULL;
 ucl_object_t *set_obj = NULL;
 struct ucl_parser *parser = NULL;
@@ -44,6 +47,7 @@ struct ucl_parser *setparser = NULL;
 char input_sepchar = '.';
 char output_sepchar = '.';
 char *include_file = NULL;
+const char *export_prefix = NULL;
 
 /*
  * This application provides a shell scripting friendly interface for reading
@@ -60,6 +64,7 @@ main(int argc, char *argv[])
     verbmap_t cmdmap[] =
     {
 	    { "get", get_main },
+	    { "find", find_main },
 	    { "set", set_main },
 	    { "merge", merge_main },
 	    { "remove", remove_main },
@@ -73,6 +78,9 @@ main(int argc, char *argv[])
 	usage();
     }
 
+    outfp = stdout;
+    /* Error exits still write out whatever was buffered before them */
+    atexit(output_flush);
     for (i = 0; cmdmap[i].verb; i++) {
 	if (strcasecmp(cmdmap[i].verb, argv[1]) != 0)
 	    continue;
@@ -103,12 +111,14 @@ void
 usage()
 {
     fprintf(stderr, "%s\n",
-"Usage: uclcmd get [-cdejklnquy] [-D char] [-f filename] variable\n"
+"Usage: uclcmd get [-0cdejklnquy] [-D char] [-f filename] [-P jobs] variable\n"
 "       uclcmd set [-cdjuy] [-D char] [-f filename] [-i filename] variable [UCL]\n"
 "       uclcmd merge [-cdjuy] [-D char] [-f filename] [-i filename] variable\n"
 "       uclcmd remove [-cdjuy] [-D char] [-f filename] variable\n"
+"       uclcmd find [-0cdEgjkKlnquVy] [-D char] [-f filename] [-P jobs] pattern [variable]\n"
 "\n"
 "COMMON OPTIONS:\n"
+"       --cache[=dir]   cache parsed files in dir, default $XDG_CACHE_HOME/uclcmd\n"
 "       -c --cjson      output compacted JSON\n"
 "       -d --debug      enable verbose debugging output\n"
 "       -D --delimiter  character to use as element delimiter (default is .)\n"
@@ -125,6 +135,18 @@ usage()
 "       UCL             A block of UCL to be written to the specified variable\n"
 "\n"
 "GET OPTIONS:\n"
+"       --csv           output table() rows as CSV rather than TSV\n"
+"       --explain       print the compiled query instead of running it\n"
+"       --export[=prefix] print everything below variable as shell assignments,\n"
+"                       quoted for eval, with names starting with prefix\n"
+"       -0 --null       end each record with a NUL instead of a newline\n"
+"       --ndjson        output one {\"path\":...,\"value\":...} JSON line per result\n"
+"       --netstring     write each record as a netstring, length:record,\n"
+"       --out FORMAT=PATH write the results as FORMAT to PATH (- for stdout)\n"
+"                       instead, may be repeated to write each concurrently.\n"
+"                       FORMAT is one of text, shellvars, export, json, cjson,\n"
+"                       ndjson, ucl or yaml\n"
+"       -P --jobs       split recurse, JSON and UCL output over this many threads\n"
 "\n"
 "SET OPTIONS:\n"
 "       -i --input      use indicated file as additional input (for combining)\n"
@@ -134,6 +156,16 @@ usage()
 "\n"
 "REMOVE OPTIONS:\n"
 "\n"
+"FIND OPTIONS:\n"
+"       -E --regex      pattern is an extended regular expression\n"
+"       -g --glob       pattern is a shell glob matching the whole key or value\n"
+"       -K --keys-only  only match keys\n"
+"       -0 --null       end each record with a NUL instead of a newline\n"
+"       --netstring     write each record as a netstring, length:record,\n"
+"       -P --jobs       search over this many threads, output is unchanged\n"
+"       -V --values-only only match values\n"
+"       pattern         without -E or -g, a string to find within keys and values\n"
+"\n"
 "EXAMPLES:\n"
 "       uclcmd get --file vmconfig .name\n"
 "           \"value\"\n"
@@ -157,10 +189,14 @@ cleanup()
 	ucl_parser_free(setparser);
     }
     if (root_obj != NULL) {
-	ucl_object_unref(root_obj);
+	walk_unref(root_obj);
     }
     if (set_obj != NULL) {
-	ucl_object_unref(set_obj);
+	walk_unref(set_obj);
     }
+    output_flush();
+    path_index_free();
+    arena_free(&scratch);
+    release_inputs();
 }
 
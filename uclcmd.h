@@ -34,19 +34,34 @@
 #ifndef UCLCMD_H_
 #define UCLCMD_H_
 
+#include <sys/stat.h>
+
 #include <errno.h>
 #include <getopt.h>
+#include <regex.h>
 #include <stdio.h>
 
 #include <ucl.h>
 
+#define UCLCMD_PARSER_FLAGS	(UCL_PARSER_KEY_LOWERCASE | \
+    UCL_PARSER_NO_IMPLICIT_ARRAYS)
+/* Strings reference the input buffers, see release_inputs() */
+#define UCLCMD_ZEROCOPY_FLAGS	(UCLCMD_PARSER_FLAGS | UCL_PARSER_ZEROCOPY)
+
+/* Deepest nesting a traversal will follow, see uclcmd_walk.c */
+#define WALK_MAX_DEPTH	1048576
+
+/* FNV-1a offset basis, see hash_bytes() */
+#define HASH_SEED	0xcbf29ce484222325ULL
+
 #ifndef __DECONST
 #define __DECONST(type, var)    ((type)(uintptr_t)(const void *)(var))
 #endif
 
-extern int debug, expand, nonewline, show_keys, show_raw;
+extern int csv, debug, expand, explain, jobs, nonewline, show_keys, show_raw;
 extern bool firstline, shvars;
 extern int output_type;
+extern int records;
 extern ucl_object_t *root_obj;
 extern ucl_object_t *set_obj;
 extern struct ucl_parser *parser;
@@ -54,6 +69,25 @@ extern struct ucl_parser *setparser;
 extern char input_sepchar;
 extern char output_sepchar;
 extern char *include_file;
+extern const char *export_prefix;
+extern char *cache_dir;
+
+/* Identifies the exact input a cache entry was built from */
+struct cache_header {
+	char magic[8];
+	uint64_t dev;
+	uint64_t ino;
+	uint64_t size;
+	int64_t mtime_sec;
+	int64_t mtime_nsec;
+	uint64_t hash;
+	uint64_t payload_len;
+};
+
+struct cache_key {
+	char *path;
+	struct cache_header hdr;
+};
 
 typedef int (*verb_func_t)(int argc, char *argv[]);
 
@@ -62,48 +96,424 @@ typedef struct verbmap {
 	verb_func_t callback;
 } verbmap_t;
 
+/*
+ * One element of a key path; index is only valid if is_index is set, or
+ * is_neg for an index counted back from the end of the array (-1). A glob
+ * segment (net*, *) matches keys or indexes with fnmatch(3), a deep segment
+ * (**) matches any number of levels, including none. A slice segment
+ * (start:stop:step) selects array elements the way a Python slice does.
+ */
+typedef struct keyseg {
+	const char *key;
+	size_t len;
+	unsigned long index;
+	long start;
+	long stop;
+	long step;
+	bool has_start;
+	bool has_stop;
+	bool is_index;
+	bool is_neg;
+	bool is_slice;
+	bool is_glob;
+	bool is_deep;
+} keyseg_t;
+
+/* Bump allocator, see uclcmd_arena.c */
+typedef struct arena_chunk {
+	struct arena_chunk *next;
+	size_t size;
+	size_t used;
+} arena_chunk_t;
+
+typedef struct arena {
+	arena_chunk_t *head;
+} arena_t;
+
+typedef struct arena_mark {
+	arena_chunk_t *chunk;
+	size_t used;
+} arena_mark_t;
+
+/* Per-invocation scratch space, reset after each query, one per thread */
+extern __thread arena_t scratch;
+
+/* Where get output goes, stdout unless a worker is capturing it */
+extern __thread FILE *outfp;
+
+/* Set on jobs_run() worker threads, see uclcmd_jobs.c */
+extern __thread bool jobs_worker_thread;
+
+/* Per-thread buffer in front of outfp, see uclcmd_output.c */
+#define OUTPUT_BUFSIZE	(64 * 1024)
+
+/* How output records are delimited, see output_record_end() */
+#define RECORDS_TEXT		0
+#define RECORDS_NUL		1
+#define RECORDS_NETSTRING	2
+
+/* output_type for --ndjson, beside 254 for text and libucl's UCL_EMIT_* */
+#define OUTPUT_NDJSON		253
+
+/* Formats one value for output_chunk(), chosen by output_init() */
+typedef void (*output_func_t)(const ucl_object_t *obj, const char *nodepath,
+    const char *key);
+
+/* A key path split on input_sepchar once, so it can be walked repeatedly */
+typedef struct keypath {
+	char *str;
+	char *buf;
+	keyseg_t *segs;
+	size_t nsegs;
+	bool wild;
+} keypath_t;
+
+/* A node selected by a wildcard path, see keypath_match() */
+typedef struct keypath_match {
+	const ucl_object_t *parent;
+	const ucl_object_t *obj;
+	const char *key;
+	unsigned long index;
+	const char *path;
+} keypath_match_t;
+
+/* Called for every match, returning false stops the search */
+typedef bool (*keypath_match_func_t)(void *ctx, const keypath_match_t *m);
+
+/* A destination path resolved to its parent node and the child within it */
+typedef struct node_ref {
+	ucl_object_t *parent;
+	ucl_object_t *child;
+	const char *key;
+	unsigned long index;
+	bool found;
+	char *prefix;
+	size_t prefixlen;
+} node_ref_t;
+
+/* Growable string builder, used for node paths and keys during traversal */
+typedef struct strbuf {
+	char *buf;
+	size_t len;
+	size_t size;
+} strbuf_t;
+
+/* One level of an iterative depth-first walk, see uclcmd_walk.c */
+typedef struct walk_frame {
+	const ucl_object_t *obj;
+	const ucl_object_t *cur;
+	const ucl_object_t *chain;
+	ucl_object_iter_t it;
+	const ucl_object_t *sub;
+	ucl_object_iter_t subit;
+	size_t pathlen;
+	int arrindex;
+	int curindex;
+	int level;
+	int ret;
+	int count;
+} walk_frame_t;
+
+typedef struct walk {
+	walk_frame_t *frames;
+	size_t depth;
+	size_t size;
+} walk_t;
+
+/* One unit of work for jobs_run(), its output is captured via outfp */
+typedef void (*job_func_t)(void *ctx, size_t index);
+
+/*
+ * One part of a parallel recurse, see recurse_parallel(): a scalar child
+ * cur of obj, or element cur2 of container child cur's implicit chain.
+ * A container whose children are tasks of their own has a subpath for
+ * them, and only outputs its own lines.
+ */
+typedef struct recurse_task {
+	const ucl_object_t *obj;
+	const ucl_object_t *cur;
+	const ucl_object_t *cur2;
+	const char *path;
+	char *subpath;
+	size_t parent;
+	int curindex;
+	int arrindex;
+	int level;
+	int ret;
+	bool settled;
+} recurse_task_t;
+
+typedef struct recurse_split {
+	recurse_task_t *tasks;
+	size_t ntasks;
+	size_t size;
+} recurse_split_t;
+
+/* Values already seen by distinct or group_by, kept in first seen order */
+typedef struct agg_entry {
+	char *key;
+	size_t len;
+	uint64_t hash;
+	const ucl_object_t *obj;
+	struct get_agg *agg;
+	struct agg_entry *next;
+	struct agg_entry *order;
+} agg_entry_t;
+
+typedef struct agg_set {
+	agg_entry_t **buckets;
+	size_t size;
+	size_t count;
+	agg_entry_t *first;
+	agg_entry_t **last;
+} agg_set_t;
+
+/*
+ * Running state of an aggregate command, a fixed size no matter how many
+ * values are reduced, except for the set distinct has to keep
+ */
+typedef struct get_agg {
+	long count;
+	long nums;
+	bool is_float;
+	int64_t isum;
+	double dsum;
+	const ucl_object_t *min;
+	const ucl_object_t *max;
+	agg_set_t *distinct;
+} get_agg_t;
+
+typedef struct get_cmd get_cmd_t;
+typedef int (*get_cmd_func_t)(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse);
+
+/*
+ * What follows a command's name: nothing, " count", "(predicate)", an
+ * optional "(path)", a required one, "(start:stop:step)" or a list of
+ * "(path,path,...)"
+ */
+#define GET_ARGS_NONE	0
+#define GET_ARGS_COUNT	1
+#define GET_ARGS_PRED	2
+#define GET_ARGS_PATH	3
+#define GET_ARGS_GROUP	4
+#define GET_ARGS_SLICE	5
+#define GET_ARGS_COLUMNS	6
+
+typedef struct get_cmdmap {
+	const char *name;
+	get_cmd_func_t callback;
+	int args;
+} get_cmdmap_t;
+
+/* Comparisons a select() predicate can make */
+typedef enum get_pred_op {
+	PRED_EXISTS,
+	PRED_EQ,
+	PRED_NE,
+	PRED_LT,
+	PRED_LE,
+	PRED_GT,
+	PRED_GE,
+	PRED_MATCH
+} get_pred_op_t;
+
+/*
+ * A compiled select(path op literal). The literal is parsed once, type is
+ * UCL_NULL, UCL_BOOLEAN, UCL_INT, UCL_FLOAT or UCL_STRING accordingly, and
+ * a regex is only compiled for PRED_MATCH.
+ */
+typedef struct get_pred {
+	keypath_t path;
+	get_pred_op_t op;
+	ucl_type_t type;
+	const char *str;
+	int64_t ival;
+	double dval;
+	bool bval;
+	regex_t re;
+} get_pred_t;
+
+/*
+ * A compiled get command, the remaining commands hang off next. seen counts
+ * the values that reached the command during the current get_run().
+ */
+struct get_cmd {
+	const get_cmdmap_t *def;
+	const char *str;
+	keypath_t *paths;
+	int npaths;
+	long arg;
+	get_pred_t *pred;
+	long seen;
+	get_agg_t *agg;
+	agg_set_t *groups;
+	get_cmd_t *next;
+};
+
+/* Prefix trie node used to resolve the nodes of many queries at once */
+typedef struct get_trie {
+	const keyseg_t *seg;
+	const ucl_object_t *obj;
+	struct get_trie *children;
+	struct get_trie *sibling;
+} get_trie_t;
+
+/* A compiled get query: node|command|command... */
+typedef struct get_plan {
+	arena_t arena;
+	char *query;
+	char *cmdbuf;
+	bool root;
+	keypath_t node;
+	get_cmd_t *cmds;
+} get_plan_t;
+
+void* arena_alloc(arena_t *arena, size_t size);
+void* arena_calloc(arena_t *arena, size_t nmemb, size_t size);
+char* arena_strdup(arena_t *arena, const char *str);
+arena_mark_t arena_mark(const arena_t *arena);
+void arena_release(arena_t *arena, arena_mark_t mark);
+void arena_reset(arena_t *arena);
+void arena_free(arena_t *arena);
+walk_frame_t* walk_push(walk_t *walk, const ucl_object_t *obj);
+void walk_pop(walk_t *walk);
+void walk_free(walk_t *walk);
+const ucl_object_t* walk_iter_next(const ucl_object_t **impl,
+    ucl_object_iter_t *expl);
+void walk_unref(ucl_object_t *obj);
+void cache_init(const char *dir);
+bool cache_key_init(struct cache_key *key, const char *filename,
+    const void *data, const struct stat *sb);
+void cache_key_free(struct cache_key *key);
+ucl_object_t* cache_load(struct cache_key *key);
+void cache_store(struct cache_key *key, const ucl_object_t *obj);
 void cleanup();
-char* expand_subkeys(const ucl_object_t *obj, char *nodepath);
+char* expand_subkeys(arena_t *arena, const ucl_object_t *obj);
+int find_main(int argc, char *argv[]);
+get_plan_t* get_compile(const char *query);
+void get_explain(const get_plan_t *plan);
 int get_main(int argc, char *argv[]);
+uint64_t hash_bytes(const void *data, size_t len, uint64_t seed);
 void get_mode(char *requested_node);
+void get_plan_free(get_plan_t *plan);
+void get_resolve(get_plan_t **plans, int nplans, const ucl_object_t **found);
+int get_run(const get_plan_t *plan, const ucl_object_t *found_object);
 ucl_object_t* get_object(char *selected_node);
+bool jobs_run(size_t ntasks, job_func_t func, void *ctx);
+void json_emit(const ucl_object_t *obj, bool compact);
+void json_record(const ucl_object_t *obj, const char *nodepath,
+    const char *key);
 ucl_object_t* get_parent(char *selected_node);
+void strbuf_init(strbuf_t *sb, const char *str);
+void strbuf_free(strbuf_t *sb);
+void strbuf_truncate(strbuf_t *sb, size_t len);
+void strbuf_addc(strbuf_t *sb, char c);
+void strbuf_adds(strbuf_t *sb, const char *str);
+void strbuf_addn(strbuf_t *sb, const char *str, size_t len);
+void strbuf_addi(strbuf_t *sb, int num);
+bool resolve_path(const char *selected_node, node_ref_t *ref);
+void node_ref_free(node_ref_t *ref);
+void path_index_invalidate(const node_ref_t *ref);
+void path_index_free();
+void keypath_compile(arena_t *arena, keypath_t *path, const char *str);
+const ucl_object_t* keypath_lookup(const ucl_object_t *obj,
+    const keypath_t *path);
+void keypath_print(FILE *fp, const keypath_t *path);
+void keypath_match(const ucl_object_t *obj, const keypath_t *path,
+    keypath_match_func_t func, void *ctx);
+keypath_match_t* keypath_collect(arena_t *arena, const ucl_object_t *obj,
+    const keypath_t *path, size_t *nmatches);
+void keyseg_parse(keyseg_t *ks, const char *seg);
+bool keyseg_index(const ucl_object_t *obj, const keyseg_t *seg,
+    unsigned long *index);
+size_t keyseg_slice(const keyseg_t *seg, size_t len, long *first);
+const ucl_object_t* keyseg_lookup(const ucl_object_t *obj,
+    const keyseg_t *seg);
 int merge_main(int argc, char *argv[]);
 int merge_mode(char *destination_node, char *data);
 bool merge_recursive(ucl_object_t *top, ucl_object_t *elt, bool copy);
-void output_chunk(const ucl_object_t *obj, char *nodepath, const char *inkey);
+void output_chunk(const ucl_object_t *obj, const char *nodepath,
+    const char *key);
+size_t output_format_double(char *buf, size_t size, double val,
+    bool ucl_style);
+void output_double(double val, bool ucl_style);
+void output_flush();
+void output_init();
+void output_int(intmax_t num);
+void output_printf(const char *fmt, ...)
+    __attribute__((__format__(__printf__, 1, 2)));
+void output_putc(char c);
+void output_record_end();
+void output_record_start(bool spaced);
+void output_puts(const char *str);
+void output_write(const char *str, size_t len);
 int output_main(int argc, char *argv[]);
-void output_key(const ucl_object_t *obj, char *nodepath, const char *inkey);
+void output_key(const ucl_object_t *obj, const char *nodepath,
+    const char *key);
+bool input_has_file_macros(const void *data, size_t len);
 ucl_object_t* parse_file(struct ucl_parser *parser, const char *filename);
 ucl_object_t* parse_input(struct ucl_parser *parser, FILE *source);
 ucl_object_t* parse_string(struct ucl_parser *parser, char *data);
-int process_get_command(const ucl_object_t *obj, char *nodepath,
-    const char *command_str, char *remaining_commands, int recurse);
+void release_inputs();
+void retain_input(void *data, size_t len, bool mapped);
+int process_get_command(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse);
 int remove_main(int argc, char *argv[]);
 void replace_sep(char *key, char oldsep, char newsep);
 int set_main(int argc, char *argv[]);
 int set_mode(char *destination_node, char *data);
-char * type_as_string (const ucl_object_t *obj);
+const char * type_as_string (const ucl_object_t *obj);
 void ucl_obj_dump(const ucl_object_t *obj, unsigned int shift);
 void ucl_obj_dump_safe(const ucl_object_t *obj, unsigned int shift);
 void usage();
 
-int get_cmd_each(const ucl_object_t *obj, char *nodepath,
-    const char *command_str, char *remaining_commands, int recurse);
-int get_cmd_iterate(const ucl_object_t *obj, char *nodepath,
-    const char *command_str, char *remaining_commands, int recurse);
-int get_cmd_keys(const ucl_object_t *obj, char *nodepath,
-    const char *command_str, char *remaining_commands, int recurse);
-int get_cmd_length(const ucl_object_t *obj, char *nodepath,
-    const char *command_str, char *remaining_commands, int recurse);
-int get_cmd_none(const ucl_object_t *obj, char *nodepath,
-    const char *command_str, char *remaining_commands, int recurse);
-int get_cmd_recurse(const ucl_object_t *obj, char *nodepath,
-    const char *command_str, char *remaining_commands, int recurse);
-int get_cmd_type(const ucl_object_t *obj, char *nodepath,
-    const char *command_str, char *remaining_commands, int recurse);
-int get_cmd_values(const ucl_object_t *obj, char *nodepath,
-    const char *command_str, char *remaining_commands, int recurse);
+int get_cmd_dump(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse);
+int get_cmd_any(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse);
+int get_cmd_avg(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse);
+int get_cmd_count(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse);
+int get_cmd_distinct(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse);
+int get_cmd_each(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse);
+int get_cmd_exists(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse);
+int get_cmd_first(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse);
+int get_cmd_group_by(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse);
+int get_cmd_iterate(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse);
+int get_cmd_keys(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse);
+int get_cmd_length(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse);
+int get_cmd_limit(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse);
+int get_cmd_max(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse);
+int get_cmd_min(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse);
+int get_cmd_none(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse);
+int get_cmd_recurse(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse);
+int get_cmd_select(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse);
+int get_cmd_slice(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse);
+int get_cmd_sum(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse);
+int get_cmd_tab(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse);
+int get_cmd_type(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse);
+int get_cmd_values(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse);
 
 
 #endif /* UCLCMD_H_ */
@@ -0,0 +1,148 @@
+/*-
+ * Copyright (c) 2014-2015 Allan Jude <allanjude@freebsd.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#include "uclcmd.h"
+
+/*
+ * Bump allocator for short-lived strings and structures.
+ *
+ * Memory is carved out of large chunks and never freed individually.
+ * Everything allocated from an arena goes away at once with arena_reset()
+ * or arena_free(), or back to an earlier point with arena_release(). A
+ * zeroed arena_t is ready to use.
+ */
+#define ARENA_CHUNK_SIZE	65536
+#define ARENA_ALIGN		16
+#define ARENA_HDR_SIZE		((sizeof(arena_chunk_t) + ARENA_ALIGN - 1) & \
+    ~(size_t)(ARENA_ALIGN - 1))
+
+void*
+arena_alloc(arena_t *arena, size_t size)
+{
+    arena_chunk_t *chunk = arena->head;
+    size_t chunksize;
+    void *ret;
+
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if (chunk == NULL || chunk->size - chunk->used < size) {
+	chunksize = ARENA_CHUNK_SIZE;
+	if (size > chunksize - ARENA_HDR_SIZE) {
+	    chunksize = size + ARENA_HDR_SIZE;
+	}
+	chunk = malloc(chunksize);
+	if (chunk == NULL) {
+	    fprintf(stderr, "Error: out of memory\n");
+	    exit(1);
+	}
+	chunk->size = chunksize;
+	chunk->used = ARENA_HDR_SIZE;
+	chunk->next = arena->head;
+	arena->head = chunk;
+    }
+    ret = (char *)chunk + chunk->used;
+    chunk->used += size;
+
+    return ret;
+}
+
+void*
+arena_calloc(arena_t *arena, size_t nmemb, size_t size)
+{
+    void *ret;
+
+    ret = arena_alloc(arena, nmemb * size);
+    memset(ret, 0, nmemb * size);
+    return ret;
+}
+
+char*
+arena_strdup(arena_t *arena, const char *str)
+{
+    size_t len = strlen(str);
+    char *ret;
+
+    ret = arena_alloc(arena, len + 1);
+    memcpy(ret, str, len + 1);
+    return ret;
+}
+
+arena_mark_t
+arena_mark(const arena_t *arena)
+{
+    arena_mark_t mark;
+
+    mark.chunk = arena->head;
+    mark.used = (arena->head != NULL) ? arena->head->used : 0;
+    return mark;
+}
+
+/*
+ * Give back everything allocated since mark was taken
+ */
+void
+arena_release(arena_t *arena, arena_mark_t mark)
+{
+    arena_chunk_t *chunk;
+
+    while ((chunk = arena->head) != NULL && chunk != mark.chunk) {
+	arena->head = chunk->next;
+	free(chunk);
+    }
+    if (arena->head != NULL) {
+	arena->head->used = mark.used;
+    }
+}
+
+/*
+ * Free everything but keep one chunk around for the next round
+ */
+void
+arena_reset(arena_t *arena)
+{
+    arena_chunk_t *chunk;
+
+    if (arena->head == NULL) {
+	return;
+    }
+    while ((chunk = arena->head->next) != NULL) {
+	arena->head->next = chunk->next;
+	free(chunk);
+    }
+    arena->head->used = ARENA_HDR_SIZE;
+}
+
+void
+arena_free(arena_t *arena)
+{
+    arena_chunk_t *chunk;
+
+    while ((chunk = arena->head) != NULL) {
+	arena->head = chunk->next;
+	free(chunk);
+    }
+}
@@ -0,0 +1,274 @@
+/*-
+ * Copyright (c) 2014-2015 Allan Jude <allanjude@freebsd.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include "uclcmd.h"
+
+#define CACHE_MAGIC	"UCLCMDC\001"
+
+/*
+ * On-disk cache of parsed files.
+ *
+ * Each input file gets one cache file in cache_dir, named after a hash of
+ * its real path. The cache file holds a header identifying the exact input
+ * it was built from, followed by the parsed tree serialized as msgpack.
+ * The entry is only used if every field of the header matches the input as
+ * it is now: device, inode, size, mtime and a hash of the full contents.
+ * Anything else (a different header, a short or corrupt file, a new cache
+ * format) is treated as a miss, the input is parsed as text and the entry
+ * is rewritten. Inputs that use .include, .load or the like are never
+ * cached, since their tree depends on files the key does not cover, and
+ * neither are trees msgpack cannot hold exactly, see cache_storable().
+ */
+char *cache_dir = NULL;
+
+void
+cache_init(const char *dir)
+{
+    const char *base = NULL;
+    char *parent = NULL;
+
+    free(cache_dir);
+    cache_dir = NULL;
+    if (dir != NULL) {
+	cache_dir = strdup(dir);
+    } else {
+	if ((base = getenv("XDG_CACHE_HOME")) != NULL && base[0] != '\0') {
+	    parent = strdup(base);
+	} else if ((base = getenv("HOME")) != NULL && base[0] != '\0') {
+	    asprintf(&parent, "%s/.cache", base);
+	} else {
+	    fprintf(stderr, "WARN: No cache directory available, not caching\n");
+	    return;
+	}
+	mkdir(parent, 0700);
+	asprintf(&cache_dir, "%s/uclcmd", parent);
+	free(parent);
+    }
+    if (mkdir(cache_dir, 0700) == -1 && errno != EEXIST) {
+	fprintf(stderr, "WARN: Unable to create cache directory %s: %s\n",
+	    cache_dir, strerror(errno));
+	free(cache_dir);
+	cache_dir = NULL;
+    }
+}
+
+bool
+cache_key_init(struct cache_key *key, const char *filename, const void *data,
+    const struct stat *sb)
+{
+    char *rpath = NULL;
+
+    memset(key, 0, sizeof(*key));
+    if (input_has_file_macros(data, sb->st_size)) {
+	if (debug > 0) {
+	    fprintf(stderr, "DEBUG: %s uses file macros, not caching\n",
+		filename);
+	}
+	return false;
+    }
+    rpath = realpath(filename, NULL);
+    if (rpath == NULL) {
+	return false;
+    }
+    asprintf(&key->path, "%s/%016jx.msgpack", cache_dir,
+	(uintmax_t)hash_bytes(rpath, strlen(rpath), HASH_SEED));
+    free(rpath);
+
+    memcpy(key->hdr.magic, CACHE_MAGIC, sizeof(key->hdr.magic));
+    key->hdr.dev = sb->st_dev;
+    key->hdr.ino = sb->st_ino;
+    key->hdr.size = sb->st_size;
+    key->hdr.mtime_sec = sb->st_mtim.tv_sec;
+    key->hdr.mtime_nsec = sb->st_mtim.tv_nsec;
+    key->hdr.hash = hash_bytes(data, sb->st_size, HASH_SEED);
+
+    return true;
+}
+
+void
+cache_key_free(struct cache_key *key)
+{
+    free(key->path);
+    key->path = NULL;
+}
+
+ucl_object_t*
+cache_load(struct cache_key *key)
+{
+    struct cache_header *hdr = NULL;
+    struct ucl_parser *cparser = NULL;
+    ucl_object_t *obj = NULL;
+    unsigned char *data = MAP_FAILED;
+    struct stat sb;
+    int fd;
+
+    fd = open(key->path, O_RDONLY);
+    if (fd == -1) {
+	return NULL;
+    }
+    if (fstat(fd, &sb) == 0 && S_ISREG(sb.st_mode) &&
+	(size_t)sb.st_size > sizeof(*hdr)) {
+	data = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED) {
+	return NULL;
+    }
+
+    hdr = (struct cache_header *)data;
+    key->hdr.payload_len = sb.st_size - sizeof(*hdr);
+    if (memcmp(hdr, &key->hdr, sizeof(*hdr)) != 0) {
+	if (debug > 0) {
+	    fprintf(stderr, "DEBUG: Cache entry %s is stale\n", key->path);
+	}
+	munmap(data, sb.st_size);
+	return NULL;
+    }
+
+    /*
+     * Use a parser of our own, so a damaged entry leaves the main parser
+     * untouched for the text fallback. The tree outlives it by reference.
+     */
+    cparser = ucl_parser_new(UCLCMD_ZEROCOPY_FLAGS);
+    if (ucl_parser_add_chunk_full(cparser, data + sizeof(*hdr),
+	hdr->payload_len, 0, UCL_DUPLICATE_APPEND, UCL_PARSE_MSGPACK)) {
+	obj = ucl_parser_get_object(cparser);
+    }
+    if (obj == NULL) {
+	if (debug > 0) {
+	    fprintf(stderr, "DEBUG: Cache entry %s is unreadable: %s\n",
+		key->path, ucl_parser_get_error(cparser));
+	}
+	munmap(data, sb.st_size);
+    } else {
+	retain_input(data, sb.st_size, true);
+	if (debug > 0) {
+	    fprintf(stderr, "DEBUG: Loaded %s from cache\n", key->path);
+	}
+    }
+    ucl_parser_free(cparser);
+
+    return obj;
+}
+
+/*
+ * Whether obj reads back from msgpack exactly as it was parsed. msgpack
+ * has no time type, so UCL_TIME values would come back as UCL_FLOAT, and
+ * it drops the multiline flag the UCL emitter writes heredocs for.
+ */
+static bool
+cache_storable(const ucl_object_t *obj)
+{
+    walk_t walk;
+    walk_frame_t *frame = NULL;
+    const ucl_object_t *cur;
+    bool ok = true;
+
+    memset(&walk, 0, sizeof(walk));
+    frame = walk_push(&walk, obj);
+    frame->chain = obj;
+    while (ok && walk.depth > 0) {
+	frame = &walk.frames[walk.depth - 1];
+	cur = walk_iter_next(&frame->chain, &frame->it);
+	if (cur == NULL) {
+	    walk_pop(&walk);
+	    continue;
+	}
+	if (ucl_object_type(cur) == UCL_TIME ||
+	    (cur->flags & UCL_OBJECT_MULTILINE)) {
+	    ok = false;
+	} else if (ucl_object_type(cur) == UCL_OBJECT ||
+	    ucl_object_type(cur) == UCL_ARRAY) {
+	    frame = walk_push(&walk, cur);
+	    frame->chain = cur;
+	}
+    }
+    walk_free(&walk);
+
+    return ok;
+}
+
+void
+cache_store(struct cache_key *key, const ucl_object_t *obj)
+{
+    unsigned char *payload = NULL;
+    size_t len = 0;
+    char *tmppath = NULL;
+    bool ok = false;
+    int fd;
+
+    if (!cache_storable(obj)) {
+	if (debug > 0) {
+	    fprintf(stderr, "DEBUG: Times or multiline strings in %s, "
+		"not caching\n", key->path);
+	}
+	return;
+    }
+    payload = ucl_object_emit_len(obj, UCL_EMIT_MSGPACK, &len);
+    if (payload == NULL) {
+	return;
+    }
+    key->hdr.payload_len = len;
+
+    /* Write a temporary file and rename it, readers never see a partial one */
+    asprintf(&tmppath, "%s.XXXXXX", key->path);
+    fd = mkstemp(tmppath);
+    if (fd == -1) {
+	if (debug > 0) {
+	    fprintf(stderr, "DEBUG: Unable to create %s: %s\n", tmppath,
+		strerror(errno));
+	}
+	free(tmppath);
+	free(payload);
+	return;
+    }
+    ok = (write(fd, &key->hdr, sizeof(key->hdr)) == sizeof(key->hdr) &&
+	write(fd, payload, len) == (ssize_t)len);
+    if (close(fd) != 0) {
+	ok = false;
+    }
+    if (!ok || rename(tmppath, key->path) != 0) {
+	if (debug > 0) {
+	    fprintf(stderr, "DEBUG: Unable to write cache entry %s: %s\n",
+		key->path, strerror(errno));
+	}
+	unlink(tmppath);
+    } else if (debug > 0) {
+	fprintf(stderr, "DEBUG: Stored %s in cache\n", key->path);
+    }
+
+    free(tmppath);
+    free(payload);
+}
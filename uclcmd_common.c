@@ -26,127 +26,925 @@
  * $FreeBSD$
  */
 
+#include <ctype.h>
+#include <fnmatch.h>
+
 #include "uclcmd.h"
 
+/*
+ * Space separated list of the keys of obj, for --expand. The list is sized
+ * up front and allocated from arena, so wide objects are neither truncated
+ * nor rebuilt with repeated strcat(). For --export the keys are listed the
+ * way they appear in variable names.
+ */
 char*
-expand_subkeys(const ucl_object_t *obj, char *nodepath)
+expand_subkeys(arena_t *arena, const ucl_object_t *obj)
 {
-	char *result = NULL;
-	int count = 0;
+	char *result = NULL, *p = NULL;
+	size_t len = 0, keylen, i;
 	ucl_object_iter_t it = NULL;
 	const ucl_object_t *cur;
 
-	result = malloc(1024); /* XXX: use sbuf instead */
-	result[0] = '\0';
+	if (obj != NULL) {
+	    while ((cur = ucl_iterate_object(obj, &it, true))) {
+		if (!ucl_object_key(cur))
+		    continue;
+		len += strlen(ucl_object_key(cur)) + 1;
+	    }
+	}
+	p = result = arena_alloc(arena, len + 1);
 	if (obj != NULL) {
 	    /* Compile a list of the keys in the current object */
+	    it = NULL;
 	    while ((cur = ucl_iterate_object(obj, &it, true))) {
 		if (!ucl_object_key(cur))
 		    continue;
-		if (strlen(result) > (1024 - 5 - strlen(ucl_object_key(cur)))) {
-			result = strcat(result, " ...");
-			break;
+		if (p != result)
+		    *p++ = ' ';
+		keylen = strlen(ucl_object_key(cur));
+		memcpy(p, ucl_object_key(cur), keylen);
+		if (export_prefix != NULL) {
+		    for (i = 0; i < keylen; i++) {
+			if (!isalnum((unsigned char)p[i]))
+			    p[i] = '_';
+		    }
 		}
-		if (count)
-		    result = strcat(result, " ");
-		result = strcat(result, ucl_object_key(cur));
-		count++;
+		p += keylen;
 	    }
 	}
+	*p = '\0';
 	return result;
 }
 
-ucl_object_t*
-get_object(char *selected_node)
+/*
+ * Parse one part of a slice, which may be empty. Returns a pointer past it,
+ * or NULL if it is not a number.
+ */
+static const char*
+keyseg_slice_part(const char *p, long *val, bool *has_val)
+{
+    char *end = NULL;
+
+    *has_val = false;
+    if (*p == ':' || *p == '\0') {
+	return p;
+    }
+    if (*p != '-' && !isdigit((unsigned char)*p)) {
+	return NULL;
+    }
+    *val = strtol(p, &end, 10);
+    if (end == p || (*end != ':' && *end != '\0')) {
+	return NULL;
+    }
+    *has_val = true;
+    return end;
+}
+
+/*
+ * Classify a single path segment. Segments that are valid array indexes or
+ * slices are converted once here rather than on every lookup.
+ */
+void
+keyseg_parse(keyseg_t *ks, const char *seg)
+{
+    const char *p = NULL;
+    char *end = NULL;
+    bool has_step = false;
+
+    memset(ks, 0, sizeof(*ks));
+    ks->key = seg;
+    ks->len = strlen(seg);
+    if (seg[0] == '-' && isdigit((unsigned char)seg[1])) {
+	ks->index = strtoul(seg + 1, &end, 10);
+	ks->is_neg = (*end == '\0');
+    } else if (isdigit((unsigned char)seg[0])) {
+	ks->index = strtoul(seg, &end, 10);
+	ks->is_index = (*end == '\0');
+    }
+    if (!ks->is_index && !ks->is_neg && strchr(seg, ':') != NULL) {
+	ks->step = 1;
+	p = keyseg_slice_part(seg, &ks->start, &ks->has_start);
+	if (p != NULL && *p == ':') {
+	    p = keyseg_slice_part(p + 1, &ks->stop, &ks->has_stop);
+	}
+	if (p != NULL && *p == ':') {
+	    p = keyseg_slice_part(p + 1, &ks->step, &has_step);
+	}
+	ks->is_slice = (p != NULL && *p == '\0' && ks->step != 0);
+    }
+    ks->is_deep = (strcmp(seg, "**") == 0);
+    ks->is_glob = !ks->is_deep && strpbrk(seg, "*?[") != NULL;
+}
+
+/*
+ * Split a key path into its segments. Empty segments are skipped, the same
+ * way ucl_lookup_path_char() does.
+ */
+void
+keypath_compile(arena_t *arena, keypath_t *path, const char *str)
+{
+    char *p = NULL, *seg = NULL;
+    keyseg_t *ks = NULL;
+
+    memset(path, 0, sizeof(*path));
+    path->str = arena_strdup(arena, str);
+    path->buf = arena_strdup(arena, str);
+    path->segs = arena_calloc(arena, strlen(str) / 2 + 1,
+	sizeof(*path->segs));
+
+    p = path->buf;
+    while (p != NULL) {
+	seg = p;
+	p = strchr(p, input_sepchar);
+	if (p != NULL) {
+	    *p++ = '\0';
+	}
+	if (*seg == '\0') {
+	    continue;
+	}
+	if (strcmp(seg, "**") == 0 && path->nsegs > 0 &&
+	    path->segs[path->nsegs - 1].is_deep) {
+	    /* a.**.** selects the same nodes as a.**, just more than once */
+	    continue;
+	}
+	ks = &path->segs[path->nsegs++];
+	keyseg_parse(ks, seg);
+	if (ks->is_deep || ks->is_glob || ks->is_slice) {
+	    path->wild = true;
+	}
+    }
+}
+
+/*
+ * The index seg names in array obj, counting back from the end for a
+ * negative one. Returns false if seg is not an index, or is before the
+ * start of the array.
+ */
+bool
+keyseg_index(const ucl_object_t *obj, const keyseg_t *seg,
+    unsigned long *index)
+{
+    if (seg->is_neg) {
+	if (seg->index == 0 || seg->index > obj->len) {
+	    return false;
+	}
+	*index = obj->len - seg->index;
+	return true;
+    }
+    *index = seg->index;
+    return seg->is_index;
+}
+
+/*
+ * The indexes slice seg selects in an array of len elements, with the same
+ * defaults and clamping as a Python slice. The first is returned in first,
+ * each of the others is step after the one before. Only arithmetic, so the
+ * cost does not depend on len.
+ */
+size_t
+keyseg_slice(const keyseg_t *seg, size_t len, long *first)
+{
+    long n = len, start, stop;
+
+    start = seg->start < 0 ? seg->start + n : seg->start;
+    stop = seg->stop < 0 ? seg->stop + n : seg->stop;
+    if (seg->step > 0) {
+	start = !seg->has_start ? 0 : start < 0 ? 0 : start > n ? n : start;
+	stop = !seg->has_stop ? n : stop < 0 ? 0 : stop > n ? n : stop;
+	*first = start;
+	return stop > start ? (stop - start + seg->step - 1) / seg->step : 0;
+    }
+    start = !seg->has_start ? n - 1 : start < -1 ? -1 :
+	start > n - 1 ? n - 1 : start;
+    stop = !seg->has_stop ? -1 : stop < -1 ? -1 : stop > n - 1 ? n - 1 : stop;
+    *first = start;
+    return start > stop ? (start - stop - seg->step - 1) / -seg->step : 0;
+}
+
+/*
+ * Look up a single key path segment in obj
+ */
+const ucl_object_t*
+keyseg_lookup(const ucl_object_t *obj, const keyseg_t *seg)
+{
+    unsigned long index;
+
+    if (obj == NULL) {
+	return NULL;
+    }
+    if (ucl_object_type(obj) == UCL_ARRAY) {
+	if (!keyseg_index(obj, seg, &index)) {
+	    return NULL;
+	}
+	return ucl_array_find_index(obj, index);
+    }
+    return ucl_object_find_keyl(obj, seg->key, seg->len);
+}
+
+/*
+ * Walk a compiled key path down from obj, like ucl_lookup_path_char()
+ */
+const ucl_object_t*
+keypath_lookup(const ucl_object_t *obj, const keypath_t *path)
+{
+    size_t i;
+
+    if (path->nsegs == 0) {
+	return NULL;
+    }
+    for (i = 0; i < path->nsegs && obj != NULL; i++) {
+	obj = keyseg_lookup(obj, &path->segs[i]);
+    }
+
+    return obj;
+}
+
+void
+keypath_print(FILE *fp, const keypath_t *path)
+{
+    size_t i;
+
+    fprintf(fp, "%s [", path->str);
+    for (i = 0; i < path->nsegs; i++) {
+	fprintf(fp, "%s%s%s", i > 0 ? ", " : "",
+	    path->segs[i].is_index || path->segs[i].is_neg ? "#" :
+	    path->segs[i].is_glob || path->segs[i].is_deep ||
+	    path->segs[i].is_slice ? "~" : "",
+	    path->segs[i].key);
+    }
+    fprintf(fp, "]");
+}
+
+/*
+ * Does child cur of obj, at index within it, match glob segment seg
+ */
+static bool
+keyseg_match(const ucl_object_t *obj, const ucl_object_t *cur,
+    unsigned long index, const keyseg_t *seg)
+{
+    char buf[32];
+
+    if (ucl_object_type(obj) == UCL_ARRAY) {
+	snprintf(buf, sizeof(buf), "%lu", index);
+	return (fnmatch(seg->key, buf, 0) == 0);
+    }
+    if (ucl_object_key(cur) == NULL) {
+	return false;
+    }
+    return (fnmatch(seg->key, ucl_object_key(cur), 0) == 0);
+}
+
+/* One node being matched against the segments from seg on */
+typedef struct match_frame {
+	const ucl_object_t *parent;
+	const ucl_object_t *obj;
+	const char *key;
+	unsigned long index;
+	size_t seg;
+	size_t pathlen;
+	ucl_object_iter_t it;
+	unsigned long arrindex;
+	bool entered;
+} match_frame_t;
+
+static match_frame_t*
+match_push(match_frame_t **frames, size_t *depth, size_t *size)
+{
+    if (*depth == *size) {
+	if (*size >= WALK_MAX_DEPTH) {
+	    fprintf(stderr, "Error: document is nested more than %d levels "
+		"deep\n", WALK_MAX_DEPTH);
+	    cleanup();
+	    exit(1);
+	}
+	*size = *size ? *size * 2 : 64;
+	*frames = realloc(*frames, *size * sizeof(**frames));
+    }
+    memset(&(*frames)[*depth], 0, sizeof(**frames));
+    return &(*frames)[(*depth)++];
+}
+
+/*
+ * Call func for every node below obj that path selects, in document order.
+ * Literal segments are looked up directly, and only the children of a node
+ * that could still lead to a match are visited: a scalar is never pushed
+ * unless it would complete the path. The path handed to func is the
+ * concrete one, e.g. vm.disk.0.path for vm.*.0.path.
+ */
+void
+keypath_match(const ucl_object_t *obj, const keypath_t *path,
+    keypath_match_func_t func, void *ctx)
 {
-    char *dst_key = selected_node;
-    char *dst_prefix = NULL;
-    char *dst_frag = NULL;
-    ucl_object_t *parent_obj = NULL;
-    ucl_object_t *selected_obj = NULL;
+    match_frame_t *frames = NULL, *frame = NULL, next;
+    const keyseg_t *seg = NULL;
+    const ucl_object_t *cur = NULL;
+    keypath_match_t m;
+    strbuf_t buf;
+    size_t depth = 0, size = 0;
+    unsigned long index;
+    long first;
+
+    if (obj == NULL) {
+	return;
+    }
+    strbuf_init(&buf, "");
+    frame = match_push(&frames, &depth, &size);
+    frame->obj = obj;
 
+    while (depth > 0) {
+	frame = &frames[depth - 1];
+	strbuf_truncate(&buf, frame->pathlen);
+	if (!frame->entered) {
+	    frame->entered = true;
+	    if (frame->seg == path->nsegs) {
+		m.parent = frame->parent;
+		m.obj = frame->obj;
+		m.key = frame->key;
+		m.index = frame->index;
+		m.path = buf.buf;
+		depth--;
+		if (!func(ctx, &m)) {
+		    break;
+		}
+		continue;
+	    }
+	    seg = &path->segs[frame->seg];
+	    if (seg->is_deep) {
+		/* Zero levels first, then every child at this segment again */
+		next = *frame;
+		next.entered = false;
+		next.seg++;
+		*match_push(&frames, &depth, &size) = next;
+		continue;
+	    }
+	    /* A key spelled exactly like the glob is taken literally */
+	    if ((!seg->is_glob ||
+		(ucl_object_type(frame->obj) == UCL_OBJECT &&
+		ucl_object_find_keyl(frame->obj, seg->key, seg->len) != NULL)) &&
+		(!seg->is_slice || ucl_object_type(frame->obj) != UCL_ARRAY)) {
+		cur = keyseg_lookup(frame->obj, seg);
+		if (cur == NULL) {
+		    depth--;
+		    continue;
+		}
+		if (buf.len > 0) {
+		    strbuf_addc(&buf, input_sepchar);
+		}
+		index = seg->index;
+		if (seg->is_neg && ucl_object_type(frame->obj) == UCL_ARRAY) {
+		    keyseg_index(frame->obj, seg, &index);
+		    strbuf_addi(&buf, index);
+		} else {
+		    strbuf_adds(&buf, seg->key);
+		}
+		frame->parent = frame->obj;
+		frame->obj = cur;
+		frame->key = ucl_object_key(cur);
+		frame->index = index;
+		frame->seg++;
+		frame->pathlen = buf.len;
+		frame->entered = false;
+		continue;
+	    }
+	}
+
+	/*
+	 * Glob and deep segments try each child of the node in turn, a slice
+	 * steps straight to the indexes it selects
+	 */
+	seg = &path->segs[frame->seg];
+	cur = NULL;
+	index = frame->arrindex;
+	if (seg->is_slice) {
+	    if (frame->arrindex < keyseg_slice(seg, frame->obj->len, &first)) {
+		index = first + (long)frame->arrindex * seg->step;
+		cur = ucl_array_find_index(frame->obj, index);
+		frame->arrindex++;
+	    }
+	} else if (ucl_object_type(frame->obj) == UCL_OBJECT ||
+	    ucl_object_type(frame->obj) == UCL_ARRAY) {
+	    cur = ucl_iterate_object(frame->obj, &frame->it, true);
+	    if (ucl_object_type(frame->obj) == UCL_ARRAY) {
+		frame->arrindex++;
+	    }
+	}
+	if (cur == NULL) {
+	    depth--;
+	    continue;
+	}
+	memset(&next, 0, sizeof(next));
+	next.seg = frame->seg;
+	if (!seg->is_deep) {
+	    if (!seg->is_slice &&
+		!keyseg_match(frame->obj, cur, index, seg)) {
+		continue;
+	    }
+	    next.seg++;
+	}
+	if (next.seg + (seg->is_deep ? 1 : 0) < path->nsegs &&
+	    ucl_object_type(cur) != UCL_OBJECT &&
+	    ucl_object_type(cur) != UCL_ARRAY) {
+	    /* Nothing left in a scalar for the rest of the path to match */
+	    continue;
+	}
+	if (buf.len > 0) {
+	    strbuf_addc(&buf, input_sepchar);
+	}
+	if (ucl_object_type(frame->obj) == UCL_ARRAY) {
+	    strbuf_addi(&buf, index);
+	} else {
+	    strbuf_adds(&buf, ucl_object_key(cur));
+	}
+	next.parent = frame->obj;
+	next.obj = cur;
+	next.key = ucl_object_key(cur);
+	next.index = index;
+	next.pathlen = buf.len;
+	*match_push(&frames, &depth, &size) = next;
+    }
+
+    free(frames);
+    strbuf_free(&buf);
+}
+
+typedef struct match_list {
+	arena_t *arena;
+	keypath_match_t *matches;
+	size_t count;
+	size_t size;
+} match_list_t;
+
+static bool
+keypath_collect_one(void *ctx, const keypath_match_t *m)
+{
+    match_list_t *list = ctx;
+    keypath_match_t *grown = NULL;
+
+    if (list->count == list->size) {
+	list->size = list->size ? list->size * 2 : 16;
+	grown = arena_alloc(list->arena, list->size * sizeof(*grown));
+	if (list->count > 0) {
+	    memcpy(grown, list->matches, list->count * sizeof(*grown));
+	}
+	list->matches = grown;
+    }
+    list->matches[list->count] = *m;
+    list->matches[list->count].path = NULL;
+    list->count++;
+    return true;
+}
+
+static int
+match_cmp(const void *a, const void *b)
+{
+    const keypath_match_t *ma = *(const keypath_match_t * const *)a;
+    const keypath_match_t *mb = *(const keypath_match_t * const *)b;
+
+    if (ma->obj != mb->obj) {
+	return ((uintptr_t)ma->obj < (uintptr_t)mb->obj) ? -1 : 1;
+    }
+    return (ma < mb) ? -1 : (ma > mb);
+}
+
+/*
+ * Collect the matches of path below obj into an array allocated from arena,
+ * for callers that modify the tree and so cannot do so during the search.
+ * Paths such as **.a.** can reach a node more than once, later duplicates
+ * are dropped so no node is modified twice.
+ */
+keypath_match_t*
+keypath_collect(arena_t *arena, const ucl_object_t *obj,
+    const keypath_t *path, size_t *nmatches)
+{
+    match_list_t list;
+    keypath_match_t **sorted = NULL;
+    size_t i, n;
+
+    memset(&list, 0, sizeof(list));
+    list.arena = arena;
+    keypath_match(obj, path, keypath_collect_one, &list);
+
+    if (list.count > 1) {
+	sorted = arena_alloc(arena, list.count * sizeof(*sorted));
+	for (i = 0; i < list.count; i++) {
+	    sorted[i] = &list.matches[i];
+	}
+	qsort(sorted, list.count, sizeof(*sorted), match_cmp);
+	for (i = 1; i < list.count; i++) {
+	    if (sorted[i]->obj == sorted[i - 1]->obj) {
+		sorted[i]->obj = NULL;
+	    }
+	}
+	for (i = n = 0; i < list.count; i++) {
+	    if (list.matches[i].obj != NULL) {
+		list.matches[n++] = list.matches[i];
+	    }
+	}
+	list.count = n;
+    }
+
+    *nmatches = list.count;
+    return list.matches;
+}
+
+/*
+ * Growable string builder. Traversals append a path segment before
+ * descending and truncate back to the saved length afterwards, so a walk
+ * reuses one buffer instead of allocating a copy of the path for every
+ * node it visits.
+ */
+void
+strbuf_init(strbuf_t *sb, const char *str)
+{
+    sb->len = 0;
+    sb->size = 64;
+    sb->buf = malloc(sb->size);
+    sb->buf[0] = '\0';
+    if (str != NULL) {
+	strbuf_adds(sb, str);
+    }
+}
+
+void
+strbuf_free(strbuf_t *sb)
+{
+    free(sb->buf);
+    memset(sb, 0, sizeof(*sb));
+}
+
+static void
+strbuf_reserve(strbuf_t *sb, size_t len)
+{
+    if (sb->len + len + 1 <= sb->size) {
+	return;
+    }
+    while (sb->len + len + 1 > sb->size) {
+	sb->size *= 2;
+    }
+    sb->buf = realloc(sb->buf, sb->size);
+}
+
+void
+strbuf_truncate(strbuf_t *sb, size_t len)
+{
+    sb->len = len;
+    sb->buf[len] = '\0';
+}
+
+void
+strbuf_addc(strbuf_t *sb, char c)
+{
+    strbuf_reserve(sb, 1);
+    sb->buf[sb->len++] = c;
+    sb->buf[sb->len] = '\0';
+}
+
+void
+strbuf_adds(strbuf_t *sb, const char *str)
+{
+    size_t len;
+
+    /* Matches what printf("%s", NULL) used to produce here */
+    if (str == NULL) {
+	str = "(null)";
+    }
+    len = strlen(str);
+    strbuf_reserve(sb, len);
+    memcpy(sb->buf + sb->len, str, len + 1);
+    sb->len += len;
+}
+
+void
+strbuf_addn(strbuf_t *sb, const char *str, size_t len)
+{
+    strbuf_reserve(sb, len);
+    memcpy(sb->buf + sb->len, str, len);
+    sb->len += len;
+    sb->buf[sb->len] = '\0';
+}
+
+void
+strbuf_addi(strbuf_t *sb, int num)
+{
+    char tmp[12], *p = tmp + sizeof(tmp);
+    unsigned int n = (num < 0) ? -(unsigned int)num : (unsigned int)num;
+
+    *--p = '\0';
+    do {
+	*--p = '0' + n % 10;
+	n /= 10;
+    } while (n > 0);
+    if (num < 0) {
+	*--p = '-';
+    }
+    strbuf_adds(sb, p);
+}
+
+/*
+ * Memoized lookups of parent paths. Commands that touch many keys under the
+ * same node (remove a.b.k1 a.b.k2 ...) would otherwise walk a.b from the
+ * root for every one of them. Entries are keyed by the path with empty
+ * segments squeezed out, and are dropped by path_index_invalidate() when
+ * the tree under them is modified.
+ */
+typedef struct path_entry {
+	char *path;
+	size_t len;
+	uint64_t hash;
+	ucl_object_t *obj;
+	struct path_entry *next;
+} path_entry_t;
+
+static path_entry_t **path_index = NULL;
+static size_t path_index_size = 0;
+static size_t path_index_count = 0;
+
+static void
+path_index_grow()
+{
+    path_entry_t **old = path_index, *ent, *next;
+    size_t oldsize = path_index_size, i, b;
+
+    path_index_size = oldsize ? oldsize * 2 : 64;
+    path_index = calloc(path_index_size, sizeof(*path_index));
+    for (i = 0; i < oldsize; i++) {
+	for (ent = old[i]; ent != NULL; ent = next) {
+	    next = ent->next;
+	    b = ent->hash & (path_index_size - 1);
+	    ent->next = path_index[b];
+	    path_index[b] = ent;
+	}
+    }
+    free(old);
+}
+
+static path_entry_t*
+path_index_find(const char *path, size_t len, uint64_t hash)
+{
+    path_entry_t *ent;
+
+    if (path_index == NULL) {
+	return NULL;
+    }
+    for (ent = path_index[hash & (path_index_size - 1)]; ent != NULL;
+	ent = ent->next) {
+	if (ent->hash == hash && ent->len == len &&
+	    memcmp(ent->path, path, len) == 0) {
+	    return ent;
+	}
+    }
+    return NULL;
+}
+
+static void
+path_index_add(const char *path, size_t len, uint64_t hash, ucl_object_t *obj)
+{
+    path_entry_t *ent;
+    size_t b;
+
+    if (path_index_count >= path_index_size) {
+	path_index_grow();
+    }
+    ent = malloc(sizeof(*ent));
+    ent->path = strndup(path, len);
+    ent->len = len;
+    ent->hash = hash;
+    ent->obj = obj;
+    b = hash & (path_index_size - 1);
+    ent->next = path_index[b];
+    path_index[b] = ent;
+    path_index_count++;
+}
+
+/*
+ * Drop every entry at or below path. With children_only, path itself is
+ * kept and only its descendants are dropped.
+ */
+static void
+path_index_drop(const char *path, size_t len, bool children_only)
+{
+    path_entry_t **entp, *ent;
+    size_t i;
+
+    for (i = 0; i < path_index_size && path_index_count > 0; i++) {
+	entp = &path_index[i];
+	while ((ent = *entp) != NULL) {
+	    if (ent->len >= len && memcmp(ent->path, path, len) == 0 &&
+		(len == 0 || (ent->len == len && !children_only) ||
+		(ent->len > len && ent->path[len] == input_sepchar))) {
+		*entp = ent->next;
+		free(ent->path);
+		free(ent);
+		path_index_count--;
+	    } else {
+		entp = &ent->next;
+	    }
+	}
+    }
+}
+
+void
+path_index_free()
+{
+    path_index_drop("", 0, false);
+    free(path_index);
+    path_index = NULL;
+    path_index_size = 0;
+}
+
+/*
+ * Walk path from root_obj, reusing and filling in the memoized lookups of
+ * each prefix along the way. canon receives the path with empty segments
+ * squeezed out, and must hold at least len + 1 bytes.
+ */
+static ucl_object_t*
+path_index_lookup(const char *path, size_t len, char *canon, size_t *canonlen)
+{
+    const ucl_object_t *obj = root_obj;
+    path_entry_t *ent = NULL;
+    keyseg_t seg;
+    const char *p = path, *end = path + len, *sep;
+    uint64_t hash = HASH_SEED;
+    size_t clen = 0;
+
+    while (p < end && obj != NULL) {
+	sep = memchr(p, input_sepchar, end - p);
+	if (sep == NULL) {
+	    sep = end;
+	}
+	if (sep == p) {
+	    p++;
+	    continue;
+	}
+	if (clen > 0) {
+	    canon[clen++] = input_sepchar;
+	    hash = hash_bytes(&input_sepchar, 1, hash);
+	}
+	memcpy(canon + clen, p, sep - p);
+	clen += sep - p;
+	hash = hash_bytes(p, sep - p, hash);
+
+	ent = path_index_find(canon, clen, hash);
+	if (ent != NULL) {
+	    obj = ent->obj;
+	} else {
+	    canon[clen] = '\0';
+	    keyseg_parse(&seg, canon + clen - (sep - p));
+	    obj = keyseg_lookup(obj, &seg);
+	    if (obj != NULL) {
+		path_index_add(canon, clen, hash,
+		    __DECONST(ucl_object_t *, obj));
+	    }
+	}
+	p = sep;
+    }
+    canon[clen] = '\0';
+    *canonlen = clen;
+
+    /* Like ucl_lookup_path_char(), an empty path selects nothing */
+    if (clen == 0) {
+	return NULL;
+    }
+    return __DECONST(ucl_object_t *, obj);
+}
+
+/*
+ * Resolve a destination path to its parent node and the child selected in
+ * it, in a single walk. As with the old get_object(), when the last segment
+ * does not exist the child falls back to the parent. Returns false if the
+ * parent does not exist.
+ */
+bool
+resolve_path(const char *selected_node, node_ref_t *ref)
+{
+    const char *dst_key = selected_node;
+    const char *dst_frag = NULL;
+    keyseg_t seg;
+
+    memset(ref, 0, sizeof(*ref));
     if (strlen(dst_key) == 1 && dst_key[0] == input_sepchar) {
 	dst_key++;
     }
-    dst_prefix = strdup(dst_key);
-    dst_frag = strrchr(dst_prefix, input_sepchar);
+    dst_frag = strrchr(dst_key, input_sepchar);
+    ref->prefix = malloc(strlen(dst_key) + 1);
 
-    if (dst_frag == NULL || strlen(dst_frag) == 0) {
-	dst_frag = dst_key;
-	parent_obj = root_obj;
+    if (dst_frag == NULL) {
+	ref->key = dst_key;
+	ref->prefix[0] = '\0';
+	ref->parent = root_obj;
     } else {
-	/*
-	 * dst_frag is a pointer to the last period in dst_prefix, write a
-	 * null byte to split the two strings, and then advance the pointer
-	 * to the first byte after the period
-	 */
-	dst_frag[0] = '\0';
-	dst_frag++;
-	parent_obj = __DECONST(ucl_object_t *,
-	    ucl_lookup_path_char(root_obj, dst_prefix, input_sepchar));
-	if (parent_obj == NULL) {
-	    free(dst_prefix);
-	    return NULL;
+	ref->key = dst_frag + 1;
+	ref->parent = path_index_lookup(dst_key, dst_frag - dst_key,
+	    ref->prefix, &ref->prefixlen);
+	if (ref->parent == NULL) {
+	    return false;
 	}
     }
-    if (ucl_object_type(parent_obj) == UCL_ARRAY) {
-	selected_obj = __DECONST(ucl_object_t *,
-	    ucl_array_find_index(parent_obj, strtoul(dst_frag, NULL, 10)));
+    if (ucl_object_type(ref->parent) == UCL_ARRAY) {
+	keyseg_parse(&seg, ref->key);
+	if (!seg.is_neg) {
+	    ref->index = strtoul(ref->key, NULL, 10);
+	} else if (!keyseg_index(ref->parent, &seg, &ref->index)) {
+	    /* Before the start of the array, so there is no such element */
+	    ref->index = ref->parent->len;
+	}
+	ref->child = __DECONST(ucl_object_t *,
+	    ucl_array_find_index(ref->parent, ref->index));
     } else {
-	selected_obj = __DECONST(ucl_object_t *,
-	    ucl_object_find_key(parent_obj, dst_frag));
+	ref->child = __DECONST(ucl_object_t *,
+	    ucl_object_find_key(ref->parent, ref->key));
     }
-    if (selected_obj == NULL) {
-	selected_obj = parent_obj;
+    ref->found = (ref->child != NULL);
+    if (ref->child == NULL) {
+	ref->child = ref->parent;
     }
 
     if (debug > 0) {
 	fprintf(stderr, "selecting key: %s\n", dst_key);
-	fprintf(stderr, "intended sub-key: %s\n", dst_frag);
-	fprintf(stderr, "selected sub-key: %s\n", ucl_object_key(selected_obj));
+	fprintf(stderr, "intended sub-key: %s\n", ref->key);
+	fprintf(stderr, "selected sub-key: %s\n", ucl_object_key(ref->child));
     }
 
-    free(dst_prefix);
+    return true;
+}
+
+/*
+ * Forget memoized lookups that a modification of ref->child may have made
+ * stale. Removing from an array shifts the indexes of its other elements,
+ * so everything below the array goes.
+ */
+void
+path_index_invalidate(const node_ref_t *ref)
+{
+    char *path = NULL;
+    size_t len;
+
+    if (path_index_count == 0 || ref->prefix == NULL) {
+	return;
+    }
+    if (!ref->found || ucl_object_type(ref->parent) == UCL_ARRAY) {
+	path_index_drop(ref->prefix, ref->prefixlen, ref->found);
+	return;
+    }
+    len = ref->prefixlen + strlen(ref->key) + 1;
+    path = malloc(len + 1);
+    if (ref->prefixlen > 0) {
+	snprintf(path, len + 1, "%s%c%s", ref->prefix, input_sepchar,
+	    ref->key);
+    } else {
+	snprintf(path, len + 1, "%s", ref->key);
+    }
+    path_index_drop(path, strlen(path), false);
+    free(path);
+}
 
-    return selected_obj;
+void
+node_ref_free(node_ref_t *ref)
+{
+    free(ref->prefix);
+    ref->prefix = NULL;
 }
 
 ucl_object_t*
-get_parent(char *selected_node)
+get_object(char *selected_node)
 {
-    char *dst_key = selected_node;
-    char *dst_prefix = NULL;
-    char *dst_frag = NULL;
-    ucl_object_t *parent_obj = NULL;
+    node_ref_t ref;
+    ucl_object_t *obj = NULL;
 
-    if (strlen(dst_key) == 1 && dst_key[0] == input_sepchar) {
-	dst_key++;
+    if (resolve_path(selected_node, &ref)) {
+	obj = ref.child;
     }
-    dst_prefix = strdup(dst_key);
-    dst_frag = strrchr(dst_prefix, input_sepchar);
+    node_ref_free(&ref);
+    return obj;
+}
 
-    if (dst_frag == NULL || strlen(dst_frag) == 0) {
-	dst_frag = dst_key;
-	parent_obj = root_obj;
-    } else {
-	/*
-	 * dst_frag is a pointer to the last period in dst_prefix, write a
-	 * null byte to split the two strings, and then advance the pointer
-	 * to the first byte after the period
-	 */
-	dst_frag[0] = '\0';
-	dst_frag++;
-	parent_obj = __DECONST(ucl_object_t *,
-	    ucl_lookup_path_char(root_obj, dst_prefix, input_sepchar));
+ucl_object_t*
+get_parent(char *selected_node)
+{
+    node_ref_t ref;
+    ucl_object_t *obj = NULL;
+
+    if (resolve_path(selected_node, &ref)) {
+	obj = ref.parent;
     }
+    node_ref_free(&ref);
+    return obj;
+}
 
-    free(dst_prefix);
+/*
+ * FNV-1a, good enough for cache keys and hash tables and trivially fast
+ */
+uint64_t
+hash_bytes(const void *data, size_t len, uint64_t seed)
+{
+    const unsigned char *p = data;
+    uint64_t h = seed;
 
-    if (parent_obj == NULL) {
-	return NULL;
+    while (len-- > 0) {
+	h ^= *p++;
+	h *= 0x100000001b3ULL;
     }
-
-    return parent_obj;
+    return h;
 }
 
 void
@@ -162,40 +960,32 @@ replace_sep(char *key, char oldsep, char newsep)
     }
 }
 
-char *
+const char *
 type_as_string (const ucl_object_t *obj)
 {
-    char *ret = NULL;
-
     if (obj == NULL) {
 	return NULL;
-    } else if (ucl_object_type(obj) == UCL_OBJECT) {
-	asprintf(&ret, "UCL_OBJECT");
-    }
-    else if (ucl_object_type(obj) == UCL_ARRAY) {
-	asprintf(&ret, "UCL_ARRAY");
     }
-    else if (ucl_object_type(obj) == UCL_INT) {
-	asprintf(&ret, "UCL_INT");
-    }
-    else if (ucl_object_type(obj) == UCL_FLOAT) {
-	asprintf(&ret, "UCL_FLOAT");
-    }
-    else if (ucl_object_type(obj) == UCL_STRING) {
-	asprintf(&ret, "UCL_STRING");
-    }
-    else if (ucl_object_type(obj) == UCL_BOOLEAN) {
-	asprintf(&ret, "UCL_BOOLEAN");
-    }
-    else if (ucl_object_type(obj) == UCL_TIME) {
-	asprintf(&ret, "UCL_TIME");
-    }
-    else if (ucl_object_type(obj) == UCL_USERDATA) {
-	asprintf(&ret, "UCL_USERDATA");
-    }
-    else if (ucl_object_type(obj) == UCL_NULL) {
-	asprintf(&ret, "UCL_NULL");
+    switch (ucl_object_type(obj)) {
+    case UCL_OBJECT:
+	return "UCL_OBJECT";
+    case UCL_ARRAY:
+	return "UCL_ARRAY";
+    case UCL_INT:
+	return "UCL_INT";
+    case UCL_FLOAT:
+	return "UCL_FLOAT";
+    case UCL_STRING:
+	return "UCL_STRING";
+    case UCL_BOOLEAN:
+	return "UCL_BOOLEAN";
+    case UCL_TIME:
+	return "UCL_TIME";
+    case UCL_USERDATA:
+	return "UCL_USERDATA";
+    case UCL_NULL:
+	return "UCL_NULL";
+    default:
+	return NULL;
     }
-
-    return ret;
 }
@@ -0,0 +1,505 @@
+/*-
+ * Copyright (c) 2014-2015 Allan Jude <allanjude@freebsd.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#include <fnmatch.h>
+#include <limits.h>
+
+#include "uclcmd.h"
+
+/*
+ * Reverse lookup: print the path of every key or value that matches a
+ * pattern. Literal patterns are substring searches with a Horspool skip
+ * table built once up front, since every scalar in the tree is tested.
+ */
+
+typedef enum find_kind {
+	FIND_LITERAL,
+	FIND_GLOB,
+	FIND_REGEX
+} find_kind_t;
+
+typedef struct find_pattern {
+	find_kind_t kind;
+	const char *str;
+	size_t len;
+	size_t skip[UCHAR_MAX + 1];
+	regex_t re;
+	bool keys;
+	bool values;
+} find_pattern_t;
+
+/* One child of the node a parallel find is split at */
+typedef struct find_task {
+	const ucl_object_t *cur;
+	int index;
+	size_t found;
+} find_task_t;
+
+typedef struct find_split {
+	const find_pattern_t *pat;
+	const ucl_object_t *obj;
+	const char *path;
+	find_task_t *tasks;
+} find_split_t;
+
+static void
+find_compile(find_pattern_t *pat, const char *str)
+{
+    size_t i;
+    int err;
+    char errbuf[128];
+
+    pat->str = str;
+    pat->len = strlen(str);
+    if (pat->kind == FIND_REGEX) {
+	err = regcomp(&pat->re, str, REG_EXTENDED | REG_NOSUB);
+	if (err != 0) {
+	    regerror(err, &pat->re, errbuf, sizeof(errbuf));
+	    fprintf(stderr, "Error: invalid regex %s: %s\n", str, errbuf);
+	    exit(1);
+	}
+    } else if (pat->kind == FIND_LITERAL) {
+	for (i = 0; i <= UCHAR_MAX; i++) {
+	    pat->skip[i] = pat->len;
+	}
+	for (i = 0; i + 1 < pat->len; i++) {
+	    pat->skip[(unsigned char)str[i]] = pat->len - 1 - i;
+	}
+    }
+}
+
+/*
+ * Do the len bytes at s match pat. Only literals honour len, for globs and
+ * regexes s must be NUL terminated.
+ */
+static bool
+find_match(const find_pattern_t *pat, const char *s, size_t len)
+{
+    const unsigned char *p = (const unsigned char *)s;
+    size_t last = pat->len - 1, i = 0;
+
+    switch (pat->kind) {
+    case FIND_GLOB:
+	return (fnmatch(pat->str, s, 0) == 0);
+    case FIND_REGEX:
+	return (regexec(&pat->re, s, 0, NULL, 0) == 0);
+    case FIND_LITERAL:
+	if (pat->len == 0) {
+	    return true;
+	}
+	while (i + pat->len <= len) {
+	    if (p[i + last] == (unsigned char)pat->str[last] &&
+		memcmp(p + i, pat->str, last) == 0) {
+		return true;
+	    }
+	    i += pat->skip[p[i + last]];
+	}
+	return false;
+    }
+    return false;
+}
+
+/* NUL terminated copy of the value being matched, per thread */
+static __thread strbuf_t valbuf;
+
+/*
+ * Does the value of scalar obj match pat, compared as the text it would be
+ * written out as in the default text output
+ */
+static bool
+find_match_value(const find_pattern_t *pat, const ucl_object_t *obj)
+{
+    const char *str = NULL;
+    char num[512];
+    size_t len;
+
+    switch (ucl_object_type(obj)) {
+    case UCL_STRING:
+	str = ucl_object_tolstring(obj, &len);
+	if (pat->kind != FIND_LITERAL) {
+	    /*
+	     * Globs and regexes need a NUL terminated string. Zero-copy
+	     * strings are not, and tostring would malloc a copy of each.
+	     */
+	    if (valbuf.buf == NULL) {
+		strbuf_init(&valbuf, NULL);
+	    }
+	    strbuf_truncate(&valbuf, 0);
+	    strbuf_addn(&valbuf, str, len);
+	    str = valbuf.buf;
+	}
+	return find_match(pat, str, len);
+    case UCL_INT:
+	len = snprintf(num, sizeof(num), "%jd",
+	    (intmax_t)ucl_object_toint(obj));
+	return find_match(pat, num, len);
+    case UCL_FLOAT:
+    case UCL_TIME:
+	len = output_format_double(num, sizeof(num),
+	    ucl_object_todouble(obj), false);
+	return find_match(pat, num, len);
+    case UCL_BOOLEAN:
+	str = ucl_object_toboolean(obj) ? "true" : "false";
+	return find_match(pat, str, strlen(str));
+    case UCL_NULL:
+	return find_match(pat, "null", 4);
+    default:
+	return false;
+    }
+}
+
+/*
+ * Check child cur of obj, whose full path is in nodepath, and print the
+ * path if its key or value matches. Returns whether it did.
+ */
+static bool
+find_node(const find_pattern_t *pat, const ucl_object_t *obj,
+    const ucl_object_t *cur, strbuf_t *nodepath)
+{
+    const char *key = NULL;
+    bool hit = false;
+
+    if (pat->keys && ucl_object_type(obj) == UCL_OBJECT &&
+	(key = ucl_object_key(cur)) != NULL) {
+	hit = find_match(pat, key, strlen(key));
+    }
+    if (!hit && pat->values) {
+	hit = find_match_value(pat, cur);
+    }
+    if (!hit) {
+	return false;
+    }
+
+    if (show_keys == 1) {
+	output_chunk(cur, nodepath->buf, "");
+	return true;
+    }
+    output_record_start(true);
+    output_puts(nodepath->buf);
+    output_record_end();
+    return true;
+}
+
+/*
+ * Append the path segment of child cur of obj, at index in an array
+ */
+static void
+find_segment(strbuf_t *nodepath, const ucl_object_t *obj,
+    const ucl_object_t *cur, int index)
+{
+    if (nodepath->len > 0) {
+	strbuf_addc(nodepath, output_sepchar);
+    }
+    if (ucl_object_type(obj) == UCL_ARRAY) {
+	strbuf_addi(nodepath, index);
+    } else {
+	strbuf_adds(nodepath, ucl_object_key(cur));
+    }
+}
+
+/*
+ * Check everything below obj, whose path is in nodepath, in document order.
+ * Returns the number of matches.
+ */
+static size_t
+find_walk(const find_pattern_t *pat, const ucl_object_t *obj,
+    strbuf_t *nodepath)
+{
+    walk_t walk;
+    walk_frame_t *frame = NULL;
+    const ucl_object_t *cur;
+    size_t pathlen = nodepath->len, found = 0;
+
+    memset(&walk, 0, sizeof(walk));
+    frame = walk_push(&walk, obj);
+    frame->pathlen = nodepath->len;
+
+    while (walk.depth > 0) {
+	frame = &walk.frames[walk.depth - 1];
+	strbuf_truncate(nodepath, frame->pathlen);
+	cur = ucl_iterate_object(frame->obj, &frame->it, true);
+	if (cur == NULL) {
+	    walk_pop(&walk);
+	    continue;
+	}
+	find_segment(nodepath, frame->obj, cur, frame->arrindex++);
+	if (find_node(pat, frame->obj, cur, nodepath)) {
+	    found++;
+	}
+	if (ucl_object_type(cur) == UCL_OBJECT ||
+	    ucl_object_type(cur) == UCL_ARRAY) {
+	    frame = walk_push(&walk, cur);
+	    frame->pathlen = nodepath->len;
+	}
+    }
+
+    strbuf_truncate(nodepath, pathlen);
+    walk_free(&walk);
+
+    return found;
+}
+
+/*
+ * Check one child of the node a parallel find was split at, and everything
+ * below it. Runs on a worker thread.
+ */
+static void
+find_job(void *ctx, size_t index)
+{
+    find_split_t *split = ctx;
+    find_task_t *task = &split->tasks[index];
+    strbuf_t nodepath;
+
+    strbuf_init(&nodepath, split->path);
+    find_segment(&nodepath, split->obj, task->cur, task->index);
+    if (find_node(split->pat, split->obj, task->cur, &nodepath)) {
+	task->found++;
+    }
+    if (ucl_object_type(task->cur) == UCL_OBJECT ||
+	ucl_object_type(task->cur) == UCL_ARRAY) {
+	task->found += find_walk(split->pat, task->cur, &nodepath);
+    }
+    strbuf_free(&nodepath);
+    strbuf_free(&valbuf);
+}
+
+/*
+ * Split the search below obj at its children and hand them to jobs_run(),
+ * which prints their matches in document order
+ */
+static size_t
+find_parallel(const find_pattern_t *pat, const ucl_object_t *obj,
+    strbuf_t *nodepath)
+{
+    find_split_t split;
+    ucl_object_iter_t it = NULL;
+    size_t ntasks = 0, found = 0, i;
+
+    while (ucl_iterate_object(obj, &it, true) != NULL) {
+	ntasks++;
+    }
+    if (ntasks < 2) {
+	return find_walk(pat, obj, nodepath);
+    }
+
+    split.pat = pat;
+    split.obj = obj;
+    split.path = nodepath->buf;
+    split.tasks = calloc(ntasks, sizeof(*split.tasks));
+    if (split.tasks == NULL) {
+	return find_walk(pat, obj, nodepath);
+    }
+    it = NULL;
+    for (i = 0; i < ntasks; i++) {
+	split.tasks[i].cur = ucl_iterate_object(obj, &it, true);
+	split.tasks[i].index = i;
+    }
+
+    if (!jobs_run(ntasks, find_job, &split)) {
+	free(split.tasks);
+	return find_walk(pat, obj, nodepath);
+    }
+    for (i = 0; i < ntasks; i++) {
+	found += split.tasks[i].found;
+    }
+    free(split.tasks);
+
+    return found;
+}
+
+int
+find_main(int argc, char *argv[])
+{
+    const char *filename = NULL;
+    const ucl_object_t *obj = NULL;
+    find_pattern_t pat;
+    keypath_t path;
+    strbuf_t nodepath;
+    size_t found = 0;
+    int ret = 0, ch;
+
+    /* Initialize parser */
+    parser = ucl_parser_new(UCLCMD_PARSER_FLAGS);
+    memset(&pat, 0, sizeof(pat));
+    pat.kind = FIND_LITERAL;
+    pat.keys = pat.values = true;
+
+    /*	options	descriptor */
+    static struct option longopts[] = {
+	{ "cache",	optional_argument,	NULL,		'C' },
+	{ "cjson",	no_argument,		&output_type,
+	    UCL_EMIT_JSON_COMPACT },
+	{ "debug",	optional_argument,	NULL,		'd' },
+	{ "delimiter",	required_argument,	NULL,		'D' },
+	{ "file",	required_argument,	NULL,		'f' },
+	{ "glob",	no_argument,		NULL,		'g' },
+	{ "json",	no_argument,		&output_type,
+	    UCL_EMIT_JSON },
+	{ "jobs",	required_argument,	NULL,		'P' },
+	{ "keys",	no_argument,		&show_keys,	1 },
+	{ "keys-only",	no_argument,		NULL,		'K' },
+	{ "netstring",	no_argument,		&records,
+	    RECORDS_NETSTRING },
+	{ "nonewline",	no_argument,		&nonewline,	1 },
+	{ "null",	no_argument,		&records,	RECORDS_NUL },
+	{ "noquote",	no_argument,		&show_raw,	1 },
+	{ "regex",	no_argument,		NULL,		'E' },
+	{ "shellvars",	no_argument,		NULL,		'l' },
+	{ "ucl",	no_argument,		&output_type,
+	    UCL_EMIT_CONFIG },
+	{ "values-only", no_argument,		NULL,		'V' },
+	{ "yaml",	no_argument,		&output_type,	UCL_EMIT_YAML },
+	{ NULL,		0,			NULL,		0 }
+    };
+
+    while ((ch = getopt_long(argc, argv, "0cdD:Ef:gjkKlnP:quVy", longopts, NULL)) != -1) {
+	switch (ch) {
+	case '0':
+	    records = RECORDS_NUL;
+	    break;
+	case 'c':
+	    output_type = UCL_EMIT_JSON_COMPACT;
+	    break;
+	case 'd':
+	    if (optarg != NULL) {
+		debug = strtol(optarg, NULL, 0);
+	    } else {
+		debug = 1;
+	    }
+	    break;
+	case 'D':
+	    input_sepchar = optarg[0];
+	    output_sepchar = optarg[0];
+	    break;
+	case 'C':
+	    cache_init(optarg);
+	    break;
+	case 'E':
+	    pat.kind = FIND_REGEX;
+	    break;
+	case 'f':
+	    filename = optarg;
+	    break;
+	case 'g':
+	    pat.kind = FIND_GLOB;
+	    break;
+	case 'j':
+	    output_type = UCL_EMIT_JSON;
+	    break;
+	case 'k':
+	    show_keys = 1;
+	    break;
+	case 'K':
+	    pat.values = false;
+	    break;
+	case 'l':
+	    shvars = true;
+	    output_sepchar = '_';
+	    break;
+	case 'n':
+	    nonewline = 1;
+	    break;
+	case 'P':
+	    jobs = strtol(optarg, NULL, 0);
+	    if (jobs < 1) {
+		fprintf(stderr, "Error: --jobs must be at least 1\n");
+		usage();
+	    }
+	    break;
+	case 'q':
+	    show_raw = 1;
+	    break;
+	case 'u':
+	    output_type = UCL_EMIT_CONFIG;
+	    break;
+	case 'V':
+	    pat.keys = false;
+	    break;
+	case 'y':
+	    output_type = UCL_EMIT_YAML;
+	    break;
+	case 0:
+	    break;
+	default:
+	    fprintf(stderr, "Error: Unexpected option: %i\n", ch);
+	    usage();
+	    break;
+	}
+    }
+    argc -= optind;
+    argv += optind;
+    output_init();
+
+    if (argc == 0 || argc > 2 || (!pat.keys && !pat.values)) {
+	usage();
+    }
+    find_compile(&pat, argv[0]);
+
+    if (filename == NULL || strcmp(filename, "-") == 0) {
+	/* Input from STDIN */
+	root_obj = parse_input(parser, stdin);
+    } else {
+	root_obj = parse_file(parser, filename);
+    }
+
+    /* Search below the given node, or the whole tree */
+    obj = root_obj;
+    strbuf_init(&nodepath, "");
+    if (argc > 1) {
+	keypath_compile(&scratch, &path, argv[1]);
+	obj = keypath_lookup(root_obj, &path);
+	strbuf_adds(&nodepath, path.str);
+    }
+    if (ucl_object_type(obj) == UCL_OBJECT ||
+	ucl_object_type(obj) == UCL_ARRAY) {
+	if (jobs > 1 && !nonewline) {
+	    found = find_parallel(&pat, obj, &nodepath);
+	} else {
+	    found = find_walk(&pat, obj, &nodepath);
+	}
+    }
+    if (debug > 0) {
+	fprintf(stderr, "DEBUG: Found %zu matches for %s\n", found, pat.str);
+    }
+    /* Like grep, the exit status says whether anything matched */
+    if (found == 0) {
+	ret = 1;
+    }
+
+    strbuf_free(&nodepath);
+    strbuf_free(&valbuf);
+    if (pat.kind == FIND_REGEX) {
+	regfree(&pat.re);
+    }
+    cleanup();
+
+    if (nonewline) {
+	printf("\n");
+    }
+    return(ret);
+}
@@ -26,32 +26,348 @@
  * $FreeBSD$
  */
 
+#include <sys/wait.h>
+
+#include <ctype.h>
+#include <unistd.h>
+
 #include "uclcmd.h"
 
+/*
+ * A parallel recurse is split into this many tasks per thread, going at
+ * most this many levels below the node it starts at
+ */
+#define RECURSE_TASKS_PER_JOB	8
+#define RECURSE_SPLIT_DEPTH	16
+
+/* Scratch buffer for the key suffixes handed to output_chunk(), per thread */
+static __thread strbuf_t keybuf;
+
+/*
+ * Set by a short-circuiting command (first, limit, exists, any) once it has
+ * its answer, so the commands feeding it stop producing values
+ */
+static bool halted;
+
+/* Canonical form of the value being aggregated, see agg_key() */
+static strbuf_t aggkey;
+
+static void agg_output(const get_cmd_t *, const get_agg_t *, const char *,
+    const char *, bool);
+static agg_entry_t *agg_set_add(agg_set_t *, bool *);
+
+/*
+ * Build the "<sep><index>" or "<sep><key>" suffix that labels child cur of
+ * obj. The result lives in keybuf and is only valid until the next call.
+ */
+static const char *
+child_key(const ucl_object_t *obj, const ucl_object_t *cur, int arrindex)
+{
+    strbuf_truncate(&keybuf, 0);
+    strbuf_addc(&keybuf, output_sepchar);
+    if (ucl_object_type(obj) == UCL_ARRAY) {
+	strbuf_addi(&keybuf, arrindex);
+    } else {
+	strbuf_adds(&keybuf, ucl_object_key(cur));
+    }
+    return keybuf.buf;
+}
+
+/*
+ * Append the path segment for child cur of obj to nodepath. Returns the
+ * previous length, to truncate back to once the child has been processed.
+ */
+static size_t
+push_child(strbuf_t *nodepath, const ucl_object_t *obj,
+    const ucl_object_t *cur, int arrindex)
+{
+    size_t len = nodepath->len;
+
+    strbuf_addc(nodepath, output_sepchar);
+    if (ucl_object_type(obj) == UCL_ARRAY) {
+	strbuf_addi(nodepath, arrindex);
+    } else {
+	strbuf_adds(nodepath, ucl_object_key(cur));
+    }
+    return len;
+}
+
+/* An output format an --out sink can be written in */
+typedef struct get_sink_format {
+	const char *name;
+	int output_type;
+	bool shellvars;
+	bool export;
+} get_sink_format_t;
+
+static const get_sink_format_t get_sink_formats[] = {
+    { "text",		254 },
+    { "shellvars",	254,			true },
+    { "export",		254,			true,	true },
+    { "json",		UCL_EMIT_JSON },
+    { "cjson",		UCL_EMIT_JSON_COMPACT },
+    { "ndjson",		OUTPUT_NDJSON },
+    { "ucl",		UCL_EMIT_CONFIG },
+    { "yaml",		UCL_EMIT_YAML },
+    { NULL }
+};
+
+/* One --out FORMAT=PATH */
+typedef struct get_sink {
+	const get_sink_format_t *format;
+	const char *path;
+} get_sink_t;
+
+/*
+ * --export is the --keys --shellvars --expand recurse output, quoted for
+ * eval
+ */
+/*
+ * Turn the argument of --export into a prefix that can start a shell
+ * variable name, by replacing characters the same way output_export_name()
+ * does in keys. It is kept for the whole run.
+ */
+static const char*
+get_export_prefix(const char *arg)
+{
+    char *prefix = NULL, *p = NULL;
+
+    if (arg == NULL) {
+	return "";
+    }
+    p = prefix = malloc(strlen(arg) + 2);
+    if (isdigit((unsigned char)arg[0])) {
+	*p++ = '_';
+    }
+    for (; *arg != '\0'; arg++) {
+	*p++ = isalnum((unsigned char)*arg) ? *arg : '_';
+    }
+    *p = '\0';
+
+    return prefix;
+}
+
+static void
+get_export_init()
+{
+    output_type = 254;
+    show_keys = 1;
+    expand = 1;
+    shvars = true;
+    output_sepchar = '_';
+}
+
+/*
+ * Compile, look up and run every query, or only print them for --explain.
+ * Returns the exit status.
+ */
+static int
+get_queries(int argc, char *argv[])
+{
+    get_plan_t **plans = NULL;
+    const ucl_object_t **found = NULL;
+    strbuf_t query;
+    int ret = 0, k;
+
+    /*
+     * Compile every query first, so the nodes they select can all be
+     * looked up together before any output is produced.
+     */
+    plans = calloc(argc, sizeof(*plans));
+    found = calloc(argc, sizeof(*found));
+    for (k = 0; k < argc; k++) {
+	if (export_prefix != NULL) {
+	    strbuf_init(&query, argv[k]);
+	    strbuf_adds(&query, "|recurse");
+	    plans[k] = get_compile(query.buf);
+	    strbuf_free(&query);
+	} else {
+	    plans[k] = get_compile(argv[k]);
+	}
+    }
+    if (explain) {
+	for (k = 0; k < argc; k++) {
+	    get_explain(plans[k]);
+	}
+    } else {
+	get_resolve(plans, argc, found);
+	for (k = 0; k < argc; k++) {
+	    if (get_run(plans[k], found[k]) != 0) {
+		ret = 1;
+	    }
+	}
+    }
+    for (k = 0; k < argc; k++) {
+	get_plan_free(plans[k]);
+    }
+    free(plans);
+    free(found);
+
+    return(ret);
+}
+
+/*
+ * Parse an --out FORMAT=PATH argument
+ */
+static void
+get_sink_add(get_sink_t **sinks, int *nsinks, char *arg)
+{
+    char *path = NULL;
+    int i, k;
+
+    path = strchr(arg, '=');
+    if (path == NULL || path[1] == '\0') {
+	fprintf(stderr, "Error: --out requires FORMAT=PATH: %s\n", arg);
+	usage();
+    }
+    *path++ = '\0';
+    for (i = 0; get_sink_formats[i].name != NULL; i++) {
+	if (strcmp(get_sink_formats[i].name, arg) == 0) {
+	    break;
+	}
+    }
+    if (get_sink_formats[i].name == NULL) {
+	fprintf(stderr, "Error: Unknown --out format: %s\n", arg);
+	usage();
+    }
+    /* Sinks are written concurrently, and would interleave on stdout */
+    if (strcmp(path, "-") == 0) {
+	for (k = 0; k < *nsinks; k++) {
+	    if (strcmp((*sinks)[k].path, "-") == 0) {
+		fprintf(stderr, "Error: Only one --out can write to -\n");
+		usage();
+	    }
+	}
+    }
+    *sinks = realloc(*sinks, (*nsinks + 1) * sizeof(**sinks));
+    (*sinks)[*nsinks].format = &get_sink_formats[i];
+    (*sinks)[*nsinks].path = path;
+    (*nsinks)++;
+}
+
+/*
+ * Run the queries once more with the output going to sink. This is called
+ * in a child process of its own, so it is free to change the output
+ * settings it inherited.
+ */
+static int
+get_sink_run(const get_sink_t *sink, int argc, char *argv[])
+{
+    FILE *fp = NULL;
+    int ret;
+
+    if (strcmp(sink->path, "-") == 0) {
+	fp = stdout;
+    } else if ((fp = fopen(sink->path, "w")) == NULL) {
+	fprintf(stderr, "Error: Unable to open %s: %s\n", sink->path,
+	    strerror(errno));
+	return(1);
+    }
+    outfp = fp;
+    output_type = sink->format->output_type;
+    if (sink->format->shellvars) {
+	show_keys = 1;
+	shvars = true;
+	output_sepchar = '_';
+    }
+    export_prefix = NULL;
+    if (sink->format->export) {
+	export_prefix = "";
+	get_export_init();
+    }
+    output_init();
+
+    ret = get_queries(argc, argv);
+    if (nonewline) {
+	output_putc('\n');
+    }
+    output_flush();
+    if (fclose(fp) != 0) {
+	fprintf(stderr, "Error: Unable to write %s: %s\n", sink->path,
+	    strerror(errno));
+	ret = 1;
+    }
+
+    return(ret);
+}
+
+/*
+ * Write every --out sink from the tree parsed once, each in a child process
+ * of its own so they are formatted concurrently. The children share the
+ * parsed tree with the parent copy-on-write, and simply exit when done
+ * rather than tearing it down. Returns the exit status.
+ */
+static int
+get_sinks(const get_sink_t *sinks, int nsinks, int argc, char *argv[])
+{
+    pid_t *pids = NULL;
+    int ret = 0, status, i;
+
+    /* Nothing buffered may be written out once per child */
+    output_flush();
+    fflush(stdout);
+    fflush(stderr);
+
+    pids = calloc(nsinks, sizeof(*pids));
+    for (i = 0; i < nsinks; i++) {
+	pids[i] = fork();
+	if (pids[i] == 0) {
+	    _exit(get_sink_run(&sinks[i], argc, argv));
+	} else if (pids[i] == -1) {
+	    fprintf(stderr, "Error: Unable to write %s: %s\n", sinks[i].path,
+		strerror(errno));
+	    ret = 1;
+	}
+    }
+    for (i = 0; i < nsinks; i++) {
+	if (pids[i] == -1) {
+	    continue;
+	}
+	if (waitpid(pids[i], &status, 0) == -1 || !WIFEXITED(status) ||
+	    WEXITSTATUS(status) != 0) {
+	    ret = 1;
+	}
+    }
+    free(pids);
+
+    return(ret);
+}
+
 int
 get_main(int argc, char *argv[])
 {
     const char *filename = NULL;
-    int ret = 0, k = 0, ch;
+    get_sink_t *sinks = NULL;
+    int ret = 0, nsinks = 0, ch;
 
     /* Initialize parser */
-    parser = ucl_parser_new(UCL_PARSER_KEY_LOWERCASE |
-        UCL_PARSER_NO_IMPLICIT_ARRAYS);
+    parser = ucl_parser_new(UCLCMD_PARSER_FLAGS);
 
     /*	options	descriptor */
     static struct option longopts[] = {
+	{ "cache",	optional_argument,	NULL,		'C' },
 	{ "cjson",	no_argument,		&output_type,
 	    UCL_EMIT_JSON_COMPACT },
+	{ "csv",	no_argument,		&csv,		1 },
 	{ "debug",	optional_argument,	NULL,		'd' },
 	{ "delimiter",	required_argument,	NULL,		'D' },
 	{ "expand",	no_argument,		&expand,	1 },
+	{ "explain",	no_argument,		&explain,	1 },
+	{ "export",	optional_argument,	NULL,		'x' },
 	{ "file",	required_argument,	NULL,		'f' },
 	{ "json",	no_argument,		&output_type,
 	    UCL_EMIT_JSON },
 	{ "keys",	no_argument,		&show_keys,	1 },
 	{ "input",	no_argument,		NULL,		'i' },
+	{ "jobs",	required_argument,	NULL,		'P' },
+	{ "ndjson",	no_argument,		&output_type,
+	    OUTPUT_NDJSON },
+	{ "netstring",	no_argument,		&records,
+	    RECORDS_NETSTRING },
 	{ "nonewline",	no_argument,		&nonewline,	1 },
+	{ "null",	no_argument,		&records,	RECORDS_NUL },
 	{ "noquote",	no_argument,		&show_raw,	1 },
+	{ "out",	required_argument,	NULL,		'o' },
 	{ "shellvars",	no_argument,		NULL,		'l' },
 	{ "ucl",	no_argument,		&output_type,
 	    UCL_EMIT_CONFIG },
@@ -59,8 +375,11 @@ get_main(int argc, char *argv[])
 	{ NULL,		0,			NULL,		0 }
     };
 
-    while ((ch = getopt_long(argc, argv, "cdD:ef:i:jklnquy", longopts, NULL)) != -1) {
+    while ((ch = getopt_long(argc, argv, "0cdD:ef:i:jklnP:quy", longopts, NULL)) != -1) {
 	switch (ch) {
+	case '0':
+	    records = RECORDS_NUL;
+	    break;
 	case 'c':
 	    output_type = UCL_EMIT_JSON_COMPACT;
 	    break;
@@ -78,14 +397,11 @@ get_main(int argc, char *argv[])
 	case 'e':
 	    expand = 1;
 	    break;
+	case 'C':
+	    cache_init(optarg);
+	    break;
 	case 'f':
 	    filename = optarg;
-	    if (strcmp(optarg, "-") == 0) {
-		/* Input from STDIN */
-		root_obj = parse_input(parser, stdin);
-	    } else {
-		root_obj = parse_file(parser, filename);
-	    }
 	    break;
 	case 'i':
 	    printf("Not implemented yet\n");
@@ -104,12 +420,25 @@ get_main(int argc, char *argv[])
 	case 'n':
 	    nonewline = 1;
 	    break;
+	case 'o':
+	    get_sink_add(&sinks, &nsinks, optarg);
+	    break;
+	case 'P':
+	    jobs = strtol(optarg, NULL, 0);
+	    if (jobs < 1) {
+		fprintf(stderr, "Error: --jobs must be at least 1\n");
+		usage();
+	    }
+	    break;
 	case 'q':
 	    show_raw = 1;
 	    break;
 	case 'u':
 	    output_type = UCL_EMIT_CONFIG;
 	    break;
+	case 'x':
+	    export_prefix = get_export_prefix(optarg);
+	    break;
 	case 'y':
 	    output_type = UCL_EMIT_YAML;
 	    break;
@@ -123,18 +452,37 @@ get_main(int argc, char *argv[])
     }
     argc -= optind;
     argv += optind;
+    if (export_prefix != NULL && nsinks > 0) {
+	fprintf(stderr, "Error: --export cannot be combined with --out, "
+	    "use --out export=PATH\n");
+	usage();
+    }
+    if (export_prefix != NULL) {
+	get_export_init();
+    }
+    output_init();
 
     if (argc == 0) {
 	usage();
     }
 
-    if (filename == NULL) {
+    if (explain) {
+	/* Only the queries are needed */
+    } else if (filename == NULL || strcmp(filename, "-") == 0) {
+	/* Input from STDIN */
 	root_obj = parse_input(parser, stdin);
+    } else {
+	root_obj = parse_file(parser, filename);
     }
 
-    for (k = 0; k < argc; k++) {
-	get_mode(argv[k]);
+    if (nsinks > 0 && !explain) {
+	ret = get_sinks(sinks, nsinks, argc, argv);
+	free(sinks);
+	cleanup();
+	return(ret);
     }
+    free(sinks);
+    ret = get_queries(argc, argv);
 
     cleanup();
 
@@ -145,210 +493,1117 @@ get_main(int argc, char *argv[])
     return(ret);
 }
 
-void
-get_mode(char *requested_node)
+/*
+ * Commands that may follow the node in a get query, e.g. node|each|.key
+ * Anything else that starts with the delimiter is a key selector.
+ */
+static const get_cmdmap_t get_cmdmap[] = {
+    { "any",		get_cmd_any },
+    { "avg",		get_cmd_avg,		GET_ARGS_PATH },
+    { "count",		get_cmd_count,		GET_ARGS_PATH },
+    { "distinct",	get_cmd_distinct,	GET_ARGS_PATH },
+    { "dump",		get_cmd_dump },
+    { "each",		get_cmd_each },
+    { "exists",		get_cmd_exists },
+    { "first",		get_cmd_first },
+    { "group_by",	get_cmd_group_by,	GET_ARGS_GROUP },
+    { "iterate",	get_cmd_iterate },
+    { "keys",		get_cmd_keys },
+    { "length",		get_cmd_length },
+    { "limit",		get_cmd_limit,		GET_ARGS_COUNT },
+    { "max",		get_cmd_max,		GET_ARGS_PATH },
+    { "min",		get_cmd_min,		GET_ARGS_PATH },
+    { "recurse",	get_cmd_recurse },
+    { "select",		get_cmd_select,		GET_ARGS_PRED },
+    { "slice",		get_cmd_slice,		GET_ARGS_SLICE },
+    { "sum",		get_cmd_sum,		GET_ARGS_PATH },
+    { "table",		get_cmd_tab,		GET_ARGS_COLUMNS },
+    { "type",		get_cmd_type },
+    { "values",		get_cmd_values },
+    { NULL,		NULL }
+};
+
+static const get_cmdmap_t get_cmd_path = { "path", get_cmd_none };
+
+/*
+ * Aggregates reduce every value that reaches them to one result, output by
+ * get_run() once all of them have been seen
+ */
+static bool
+get_cmd_is_agg(const get_cmd_t *cmd)
 {
-    const ucl_object_t *found_object;
-    char *cmd = requested_node;
-    char *node_name = strsep(&cmd, "|");
-    char *command_str = strsep(&cmd, "|");
-    char *nodepath = NULL;
-    int command_count = 0, i;
+    get_cmd_func_t cb = cmd->def->callback;
 
-    asprintf(&nodepath, "");
-    found_object = root_obj;
+    return (cb == get_cmd_avg || cb == get_cmd_count ||
+	cb == get_cmd_distinct || cb == get_cmd_max || cb == get_cmd_min ||
+	cb == get_cmd_sum);
+}
 
-    if (strlen(node_name) == 0) {
-	/* Requested root node */
-	if (debug > 0) {
-	    fprintf(stderr, "DEBUG: Using root node\n");
+static const struct {
+	const char *str;
+	get_pred_op_t op;
+} get_pred_ops[] = {
+    { "==",	PRED_EQ },
+    { "!=",	PRED_NE },
+    { "<=",	PRED_LE },
+    { ">=",	PRED_GE },
+    { "=~",	PRED_MATCH },
+    { "<",	PRED_LT },
+    { ">",	PRED_GT },
+    { "exists",	PRED_EXISTS },
+    { NULL,	PRED_EXISTS }
+};
+
+/*
+ * strsep(stringp, "|"), except that a | inside parentheses, or inside quotes
+ * within them, does not split, so select() predicates may contain one
+ */
+static char*
+split_command(char **stringp)
+{
+    char *s = *stringp, *p = NULL;
+    char quote = '\0';
+    int depth = 0;
+
+    if (s == NULL) {
+	return NULL;
+    }
+    for (p = s; *p != '\0'; p++) {
+	if (quote != '\0') {
+	    if (*p == quote) {
+		quote = '\0';
+	    }
+	} else if (depth > 0 && (*p == '"' || *p == '\'')) {
+	    quote = *p;
+	} else if (*p == '(') {
+	    depth++;
+	} else if (*p == ')' && depth > 0) {
+	    depth--;
+	} else if (*p == '|' && depth == 0) {
+	    *p = '\0';
+	    *stringp = p + 1;
+	    return s;
 	}
-	found_object = root_obj;
-    } else if (strlen(node_name) == 1 && node_name[0] == input_sepchar) {
-	if (debug > 0) {
-	    fprintf(stderr, "DEBUG: Using root node\n");
+    }
+    *stringp = NULL;
+    return s;
+}
+
+/*
+ * Compile "path op literal" from select(...) into pred. Without an op the
+ * predicate is exists. Exits on a malformed predicate, like an invalid
+ * command.
+ */
+static void
+get_pred_compile(arena_t *arena, get_pred_t *pred, const char *text)
+{
+    char *lit = NULL, *path = NULL, *end = NULL;
+    const char *p = NULL;
+    size_t len;
+    int i, err;
+
+    memset(pred, 0, sizeof(*pred));
+    p = text + strspn(text, " ");
+    len = strcspn(p, " =!<>~");
+    path = arena_alloc(arena, len + 1);
+    memcpy(path, p, len);
+    path[len] = '\0';
+    keypath_compile(arena, &pred->path, path);
+
+    p += len;
+    lit = arena_strdup(arena, p + strspn(p, " "));
+    pred->op = PRED_EXISTS;
+    if (lit[0] != '\0') {
+	for (i = 0; get_pred_ops[i].str != NULL; i++) {
+	    len = strlen(get_pred_ops[i].str);
+	    if (strncmp(lit, get_pred_ops[i].str, len) == 0) {
+		break;
+	    }
+	}
+	if (get_pred_ops[i].str == NULL) {
+	    fprintf(stderr, "Error: invalid select operator: %s\n", text);
+	    exit(1);
+	}
+	pred->op = get_pred_ops[i].op;
+	lit += len;
+	lit += strspn(lit, " ");
+    }
+    len = strlen(lit);
+    while (len > 0 && lit[len - 1] == ' ') {
+	lit[--len] = '\0';
+    }
+    if ((pred->op == PRED_EXISTS) != (len == 0)) {
+	fprintf(stderr, "Error: invalid select predicate: %s\n", text);
+	exit(1);
+    }
+
+    /* Parse the literal once, rather than for every element */
+    pred->str = lit;
+    pred->type = UCL_STRING;
+    if (len >= 2 && (lit[0] == '"' || lit[0] == '\'') &&
+	lit[len - 1] == lit[0]) {
+	lit[len - 1] = '\0';
+	pred->str = lit + 1;
+    } else if (strcmp(lit, "null") == 0) {
+	pred->type = UCL_NULL;
+    } else if (strcmp(lit, "true") == 0 || strcmp(lit, "false") == 0) {
+	pred->type = UCL_BOOLEAN;
+	pred->bval = (lit[0] == 't');
+    } else if (len > 0) {
+	pred->ival = strtoll(lit, &end, 10);
+	if (*end == '\0') {
+	    pred->type = UCL_INT;
+	    pred->dval = (double)pred->ival;
+	} else {
+	    pred->dval = strtod(lit, &end);
+	    if (*end == '\0') {
+		pred->type = UCL_FLOAT;
+	    }
+	}
+    }
+    if (pred->op == PRED_MATCH) {
+	err = regcomp(&pred->re, pred->str, REG_EXTENDED | REG_NOSUB);
+	if (err != 0) {
+	    char errbuf[256];
+
+	    regerror(err, &pred->re, errbuf, sizeof(errbuf));
+	    fprintf(stderr, "Error: invalid regex %s: %s\n", pred->str,
+		errbuf);
+	    exit(1);
 	}
-	found_object = root_obj;
+    }
+}
+
+/*
+ * Compile a query of the form node|command|command... into a plan, so the
+ * query text is split and the commands are looked up exactly once, no
+ * matter how many objects they end up being applied to.
+ */
+get_plan_t*
+get_compile(const char *query)
+{
+    get_plan_t *plan = NULL;
+    get_cmd_t *cmd = NULL, **tail = NULL;
+    char *cmds = NULL, *node_name = NULL, *command_str = NULL;
+    char *sel = NULL, *selectors = NULL, *reqnode = NULL, *arg = NULL;
+    size_t namelen;
+    int i;
+
+    plan = calloc(1, sizeof(*plan));
+    plan->query = arena_strdup(&plan->arena, query);
+    cmds = arena_strdup(&plan->arena, query);
+    plan->cmdbuf = cmds;
+    node_name = split_command(&cmds);
+
+    if (strlen(node_name) == 0 ||
+	(strlen(node_name) == 1 && node_name[0] == input_sepchar)) {
+	/* Requested root node */
+	plan->root = true;
+	keypath_compile(&plan->arena, &plan->node, "");
     } else {
 	if (node_name[0] == input_sepchar) {
 	    /* Removing leading dot */
 	    node_name++;
 	}
-	/* Search for selected node */
-	if (debug > 0) {
-	    fprintf(stderr, "DEBUG: Searching node %s\n", node_name);
-	}
-	found_object = ucl_lookup_path_char(found_object, node_name, input_sepchar);
-	free(nodepath);
-	asprintf(&nodepath, "%s", node_name);
+	keypath_compile(&plan->arena, &plan->node, node_name);
     }
 
-    while (command_str != NULL) {
-	if (debug > 0) {
-	    fprintf(stderr, "DEBUG: Performing \"%s\" command on \"%s\"...\n",
-		command_str, node_name);
+    tail = &plan->cmds;
+    while ((command_str = split_command(&cmds)) != NULL) {
+	cmd = arena_calloc(&plan->arena, 1, sizeof(*cmd));
+	cmd->str = command_str;
+	/* Arguments are written as "name count" or "name(predicate)" */
+	namelen = strcspn(command_str, " (");
+	for (i = 0; get_cmdmap[i].name != NULL; i++) {
+	    if (strlen(get_cmdmap[i].name) == namelen &&
+		strncmp(get_cmdmap[i].name, command_str, namelen) == 0) {
+		cmd->def = &get_cmdmap[i];
+		break;
+	    }
 	}
-	int done = process_get_command(found_object, nodepath, command_str,
-	    cmd, 1);
-	if (debug >= 2) {
-	    fprintf(stderr, "DEBUG: Finished process, did: %i commands\n",
-		done);
+	if (cmd->def != NULL && cmd->def->args == GET_ARGS_PRED) {
+	    namelen = strlen(command_str);
+	    if (command_str[strlen(cmd->def->name)] != '(' ||
+		command_str[namelen - 1] != ')') {
+		fprintf(stderr, "Error: %s requires a predicate: %s\n",
+		    cmd->def->name, command_str);
+		exit(1);
+	    }
+	    arg = arena_strdup(&plan->arena,
+		command_str + strlen(cmd->def->name) + 1);
+	    arg[strlen(arg) - 1] = '\0';
+	    cmd->pred = arena_alloc(&plan->arena, sizeof(*cmd->pred));
+	    get_pred_compile(&plan->arena, cmd->pred, arg);
+	} else if (cmd->def != NULL && (cmd->def->args == GET_ARGS_PATH ||
+	    cmd->def->args == GET_ARGS_GROUP)) {
+	    if (command_str[namelen] == '(' &&
+		command_str[strlen(command_str) - 1] == ')') {
+		arg = arena_strdup(&plan->arena, command_str + namelen + 1);
+		arg[strlen(arg) - 1] = '\0';
+		cmd->paths = arena_calloc(&plan->arena, 1,
+		    sizeof(*cmd->paths));
+		keypath_compile(&plan->arena, &cmd->paths[0], arg);
+		cmd->npaths = 1;
+	    } else if (command_str[namelen] != '\0' ||
+		cmd->def->args == GET_ARGS_GROUP) {
+		fprintf(stderr, "Error: %s requires a (path): %s\n",
+		    cmd->def->name, command_str);
+		exit(1);
+	    }
+	} else if (cmd->def != NULL && cmd->def->args == GET_ARGS_SLICE) {
+	    cmd->paths = arena_calloc(&plan->arena, 1, sizeof(*cmd->paths));
+	    if (command_str[namelen] == '(' &&
+		command_str[strlen(command_str) - 1] == ')') {
+		arg = arena_strdup(&plan->arena, command_str + namelen + 1);
+		arg[strlen(arg) - 1] = '\0';
+		keypath_compile(&plan->arena, &cmd->paths[0], arg);
+		cmd->npaths = 1;
+	    }
+	    if (cmd->npaths == 0 || cmd->paths[0].nsegs != 1 ||
+		!cmd->paths[0].segs[0].is_slice) {
+		fprintf(stderr, "Error: %s requires (start:stop:step): %s\n",
+		    cmd->def->name, command_str);
+		exit(1);
+	    }
+	} else if (cmd->def != NULL && cmd->def->args == GET_ARGS_COLUMNS) {
+	    if (command_str[namelen] != '(' ||
+		command_str[strlen(command_str) - 1] != ')' ||
+		command_str[namelen + 1] == ')') {
+		fprintf(stderr, "Error: %s requires (path,path,...): %s\n",
+		    cmd->def->name, command_str);
+		exit(1);
+	    }
+	    arg = arena_strdup(&plan->arena, command_str + namelen + 1);
+	    arg[strlen(arg) - 1] = '\0';
+	    for (i = 1, sel = arg; *sel != '\0'; sel++) {
+		if (*sel == ',') {
+		    i++;
+		}
+	    }
+	    cmd->paths = arena_calloc(&plan->arena, i, sizeof(*cmd->paths));
+	    while ((reqnode = strsep(&arg, ",")) != NULL) {
+		reqnode += strspn(reqnode, " ");
+		keypath_compile(&plan->arena, &cmd->paths[cmd->npaths],
+		    reqnode);
+		cmd->npaths++;
+	    }
+	} else if (cmd->def != NULL && cmd->def->args == GET_ARGS_COUNT) {
+	    arg = NULL;
+	    if (command_str[namelen] == ' ') {
+		cmd->arg = strtol(command_str + namelen + 1, &arg, 10);
+	    }
+	    if (arg == NULL || arg == command_str + namelen + 1 ||
+		*arg != '\0' || cmd->arg < 0) {
+		fprintf(stderr, "Error: %s requires a count: %s\n",
+		    cmd->def->name, command_str);
+		exit(1);
+	    }
+	} else if (cmd->def != NULL && command_str[namelen] != '\0') {
+	    cmd->def = NULL;
 	}
-
-	for (i = 0; i < done; i++) {
-	    if (debug >= 2) {
-		fprintf(stderr, "DEBUG: Removing command: %s\n", command_str);
+	if (cmd->def == NULL && command_str[0] == input_sepchar) {
+	    /* One or more space separated key selectors */
+	    cmd->def = &get_cmd_path;
+	    selectors = arena_strdup(&plan->arena, command_str);
+	    for (i = 1, sel = selectors; *sel != '\0'; sel++) {
+		if (*sel == ' ') {
+		    i++;
+		}
+	    }
+	    cmd->paths = arena_calloc(&plan->arena, i, sizeof(*cmd->paths));
+	    while ((reqnode = strsep(&selectors, " ")) != NULL) {
+		keypath_compile(&plan->arena, &cmd->paths[cmd->npaths],
+		    reqnode);
+		cmd->npaths++;
 	    }
-	    command_str = strsep(&cmd, "|");
 	}
-	if (debug >= 2) {
-	    fprintf(stderr, "DEBUG: Remaining command: %s\n", command_str);
+	if (cmd->def == NULL) {
+	    /* Not a valid command */
+	    fprintf(stderr, "Error: invalid command %s\n", command_str);
+	    exit(1);
 	}
-	command_count += done;
+	*tail = cmd;
+	tail = &cmd->next;
     }
 
-    if (debug >= 2) {
-	fprintf(stderr, "DEBUG: Ending get_mode with command_count=%i\n",
-	    command_count);
-    }
-    if (command_count == 0) {
-	output_chunk(found_object, nodepath, "");
+    for (cmd = plan->cmds; cmd != NULL; cmd = cmd->next) {
+	if (cmd->def->args == GET_ARGS_GROUP &&
+	    (cmd->next == NULL || !get_cmd_is_agg(cmd->next))) {
+	    fprintf(stderr, "Error: %s must be followed by count, sum, min, "
+		"max, avg or distinct\n", cmd->def->name);
+	    exit(1);
+	}
+	if ((get_cmd_is_agg(cmd) || cmd->def->args == GET_ARGS_COLUMNS) &&
+	    cmd->next != NULL) {
+	    fprintf(stderr, "Error: %s must be the last command\n",
+		cmd->def->name);
+	    exit(1);
+	}
     }
-    free(nodepath);
+
+    return plan;
 }
 
-int
-process_get_command(const ucl_object_t *obj, char *nodepath,
-    const char *command_str, char *remaining_commands, int recurse)
+void
+get_plan_free(get_plan_t *plan)
 {
-    int command_count = 0, recurse_level = recurse;
+    get_cmd_t *cmd = NULL;
 
-    if (debug >= 2) {
-	fprintf(stderr, "DEBUG: Got command: %s - next command: %s\n",
-	    command_str, remaining_commands);
-    }
-    if (strcmp(command_str, "length") == 0) {
-	recurse_level = get_cmd_length(obj, nodepath, command_str,
-		remaining_commands, recurse_level);
-    } else if (strcmp(command_str, "dump") == 0) {
-	ucl_obj_dump(obj,2);
-    } else if (strcmp(command_str, "type") == 0) {
-	recurse_level = get_cmd_type(obj, nodepath, command_str,
-		remaining_commands, recurse_level);
-    } else if (strcmp(command_str, "keys") == 0) {
-	recurse_level = get_cmd_keys(obj, nodepath, command_str,
-		remaining_commands, recurse_level);
-    } else if (strcmp(command_str, "values") == 0) {
-	recurse_level = get_cmd_values(obj, nodepath, command_str,
-		remaining_commands, recurse_level);
-    } else if (strcmp(command_str, "iterate") == 0) {
-	recurse_level = get_cmd_iterate(obj, nodepath, command_str,
-		remaining_commands, recurse_level);
-    } else if (strcmp(command_str, "recurse") == 0) {
-	recurse_level = get_cmd_recurse(obj, nodepath, command_str,
-		remaining_commands, recurse_level);
-    } else if (strcmp(command_str, "each") == 0) {
-	recurse_level = get_cmd_each(obj, nodepath, command_str,
-		remaining_commands, recurse_level);
-    } else if (command_str[0] == input_sepchar) {
-	recurse_level = get_cmd_none(obj, nodepath, command_str,
-		remaining_commands, recurse_level);
-    } else {
-	/* Not a valid command */
-	fprintf(stderr, "Error: invalid command %s\n", command_str);
-	exit(1);
+    if (plan == NULL) {
+	return;
     }
-    command_count++;
-    if (debug >= 3) {
-	fprintf(stderr, "DEBUG: Returning p_g_c with c_count=%i rlevel=%i\n",
-	    command_count, recurse_level);
+    for (cmd = plan->cmds; cmd != NULL; cmd = cmd->next) {
+	if (cmd->pred != NULL && cmd->pred->op == PRED_MATCH) {
+	    regfree(&cmd->pred->re);
+	}
     }
-    return recurse_level;
+    /* Everything else the plan points to was allocated from its arena */
+    arena_free(&plan->arena);
+    free(plan);
 }
 
 /*
- * Return the number of keys in an object or items in an array
+ * Print a compiled plan, for --explain
  */
-int
-get_cmd_length(const ucl_object_t *obj, char *nodepath,
-    const char *command_str, char *remaining_commands, int recurse)
+void
+get_explain(const get_plan_t *plan)
 {
-    if (firstline == false) {
-	printf(" ");
-    }
-    if (obj == NULL) {
-	if (show_keys == 1)
-	    printf("(null)=");
-	printf("0");
+    const get_cmd_t *cmd = NULL;
+    int i, step = 0;
+
+    printf("query: %s\n", plan->query);
+    if (plan->root) {
+	printf("  node: (root)\n");
     } else {
-	if (show_keys == 1)
-	    printf("%s", nodepath);
-	printf("%u", obj->len);
+	printf("  node: ");
+	keypath_print(stdout, &plan->node);
+	printf("\n");
     }
-    if (nonewline) {
-	firstline = false;
-    } else {
+    for (cmd = plan->cmds; cmd != NULL; cmd = cmd->next) {
+	printf("  %d: %s", ++step, cmd->def->name);
+	if (cmd->def->args == GET_ARGS_COUNT) {
+	    printf(" %ld", cmd->arg);
+	} else if (cmd->def->args == GET_ARGS_PRED) {
+	    printf(" ");
+	    keypath_print(stdout, &cmd->pred->path);
+	    for (i = 0; get_pred_ops[i].str != NULL; i++) {
+		if (get_pred_ops[i].op == cmd->pred->op) {
+		    printf(" %s", get_pred_ops[i].str);
+		    break;
+		}
+	    }
+	    if (cmd->pred->op == PRED_EXISTS) {
+		/* No literal */
+	    } else if (cmd->pred->type == UCL_STRING) {
+		printf(" \"%s\"", cmd->pred->str);
+	    } else {
+		printf(" %s", cmd->pred->str);
+	    }
+	}
+	for (i = 0; i < cmd->npaths; i++) {
+	    printf(" ");
+	    keypath_print(stdout, &cmd->paths[i]);
+	}
 	printf("\n");
     }
-
-    return recurse;
 }
 
 /*
- * Return the type of the current object
+ * Look up the nodes selected by a set of plans in a single pass. The node
+ * paths are merged into a prefix trie as they are resolved, so a prefix
+ * shared by many queries (vm.disk.0.*, vm.net.*, ...) is only walked once.
+ * found[k] receives the node for plans[k].
  */
-int
-get_cmd_type(const ucl_object_t *obj, char *nodepath,
-    const char *command_str, char *remaining_commands, int recurse)
+void
+get_resolve(get_plan_t **plans, int nplans, const ucl_object_t **found)
 {
-    if (firstline == false) {
-	printf(" ");
+    get_trie_t *pool = NULL, root, *node = NULL, *child = NULL;
+    const keyseg_t *seg = NULL;
+    size_t total = 0, used = 0, i;
+    int k;
+
+    for (k = 0; k < nplans; k++) {
+	total += plans[k]->node.nsegs;
     }
-    if (obj == NULL) {
-	if (show_keys == 1)
-	    printf("(null)=");
-	printf("null");
-    } else {
-	if (show_keys == 1)
-	    printf("%s=", nodepath);
-	switch(ucl_object_type(obj)) {
-	case UCL_OBJECT:
-	    printf("object");
-	    break;
-	case UCL_ARRAY:
-	    printf("array");
-	    break;
-	case UCL_INT:
-	    printf("int");
-	    break;
-	case UCL_FLOAT:
-	    printf("float");
-	    break;
-	case UCL_STRING:
-	    printf("string");
+    pool = arena_calloc(&scratch, total + 1, sizeof(*pool));
+    memset(&root, 0, sizeof(root));
+    root.obj = root_obj;
+
+    for (k = 0; k < nplans; k++) {
+	if (plans[k]->root) {
+	    found[k] = root_obj;
+	    continue;
+	}
+	if (plans[k]->node.wild) {
+	    /* Matched by get_run(), there is no single node to resolve */
+	    found[k] = NULL;
+	    continue;
+	}
+	node = &root;
+	for (i = 0; i < plans[k]->node.nsegs; i++) {
+	    seg = &plans[k]->node.segs[i];
+	    for (child = node->children; child != NULL;
+		child = child->sibling) {
+		if (child->seg->len == seg->len &&
+		    memcmp(child->seg->key, seg->key, seg->len) == 0) {
+		    break;
+		}
+	    }
+	    if (child == NULL) {
+		child = &pool[used++];
+		child->seg = seg;
+		child->obj = keyseg_lookup(node->obj, seg);
+		child->sibling = node->children;
+		node->children = child;
+	    }
+	    node = child;
+	}
+	found[k] = (node == &root) ? NULL : node->obj;
+    }
+}
+
+/* A plan being run on every node its wildcard path matches */
+typedef struct get_match_ctx {
+	const get_plan_t *plan;
+	strbuf_t *nodepath;
+	agg_set_t *seen;
+} get_match_ctx_t;
+
+/*
+ * Run the commands of a plan on one node, whose path is in nodepath
+ */
+static void
+get_run_cmds(const get_plan_t *plan, const ucl_object_t *found_object,
+    strbuf_t *nodepath)
+{
+    const get_cmd_t *cmd = NULL;
+    int command_count = 0, i;
+
+    cmd = plan->cmds;
+    while (cmd != NULL && !halted) {
+	if (debug > 0) {
+	    fprintf(stderr, "DEBUG: Performing \"%s\" command on \"%s\"...\n",
+		cmd->str, plan->node.str);
+	}
+	int done = process_get_command(found_object, nodepath, cmd, 1);
+	if (debug >= 2) {
+	    fprintf(stderr, "DEBUG: Finished process, did: %i commands\n",
+		done);
+	}
+
+	for (i = 0; i < done && cmd != NULL; i++) {
+	    if (debug >= 2) {
+		fprintf(stderr, "DEBUG: Removing command: %s\n", cmd->str);
+	    }
+	    cmd = cmd->next;
+	}
+	if (debug >= 2) {
+	    fprintf(stderr, "DEBUG: Remaining command: %s\n",
+		cmd != NULL ? cmd->str : "(null)");
+	}
+	command_count += done;
+    }
+
+    if (debug >= 2) {
+	fprintf(stderr, "DEBUG: Ending get_run with command_count=%i\n",
+	    command_count);
+    }
+    if (command_count == 0) {
+	output_chunk(found_object, nodepath->buf, "");
+    }
+}
+
+static bool
+get_run_match(void *ctx, const keypath_match_t *m)
+{
+    get_match_ctx_t *match = ctx;
+    bool added;
+
+    if (match->seen != NULL) {
+	/* Keyed on the node itself, so each one is only run once */
+	strbuf_truncate(&aggkey, 0);
+	strbuf_addn(&aggkey, (const char *)&m->obj, sizeof(m->obj));
+	agg_set_add(match->seen, &added);
+	if (!added) {
+	    return true;
+	}
+    }
+    strbuf_truncate(match->nodepath, 0);
+    strbuf_adds(match->nodepath, m->path);
+    get_run_cmds(match->plan, m->obj, match->nodepath);
+
+    return !halted;
+}
+
+/*
+ * Run a compiled plan against its node and output the results. A wildcard
+ * plan is run once for every node it matches, in document order, as if
+ * they were the elements of an each. Returns the exit status for the
+ * query, which is only non-zero if an exists command saw nothing.
+ */
+int
+get_run(const get_plan_t *plan, const ucl_object_t *found_object)
+{
+    get_match_ctx_t match;
+    get_cmd_t *c = NULL;
+    agg_entry_t *ent = NULL;
+    ucl_object_t *result = NULL;
+    strbuf_t nodepath;
+    size_t i, deep;
+    int status = 0;
+
+    if (plan->root) {
+	if (debug > 0) {
+	    fprintf(stderr, "DEBUG: Using root node\n");
+	}
+	strbuf_init(&nodepath, "");
+    } else {
+	if (debug > 0) {
+	    fprintf(stderr, "DEBUG: Searched node %s\n", plan->node.str);
+	}
+	strbuf_init(&nodepath, plan->node.str);
+    }
+
+    strbuf_init(&keybuf, NULL);
+    strbuf_init(&aggkey, NULL);
+
+    for (c = plan->cmds; c != NULL; c = c->next) {
+	c->seen = 0;
+	c->agg = NULL;
+	c->groups = NULL;
+    }
+    halted = false;
+
+    if (plan->node.wild) {
+	match.plan = plan;
+	match.nodepath = &nodepath;
+	match.seen = NULL;
+	/*
+	 * With more than one ** a node can be reached more than once, e.g.
+	 * a.a.b by **.a.** with either a as the literal one
+	 */
+	for (i = deep = 0; i < plan->node.nsegs; i++) {
+	    if (plan->node.segs[i].is_deep) {
+		deep++;
+	    }
+	}
+	if (deep > 1) {
+	    match.seen = arena_calloc(&scratch, 1, sizeof(*match.seen));
+	}
+	keypath_match(root_obj, &plan->node, get_run_match, &match);
+	strbuf_truncate(&nodepath, 0);
+	strbuf_adds(&nodepath, plan->node.str);
+    } else {
+	get_run_cmds(plan, found_object, &nodepath);
+    }
+
+    /*
+     * The answers of aggregates, any and exists are only known once the
+     * run is over
+     */
+    for (c = plan->cmds; c != NULL; c = c->next) {
+	if (c->def->args == GET_ARGS_GROUP) {
+	    for (ent = c->groups != NULL ? c->groups->first : NULL;
+		ent != NULL; ent = ent->order) {
+		strbuf_truncate(&keybuf, 0);
+		strbuf_addc(&keybuf, output_sepchar);
+		strbuf_adds(&keybuf, ent->key + 1);
+		agg_output(c->next, ent->agg, nodepath.buf, keybuf.buf, true);
+	    }
+	    /* The aggregate after it has been output per group */
+	    c = c->next;
+	} else if (get_cmd_is_agg(c)) {
+	    agg_output(c, c->agg, nodepath.buf, "", false);
+	} else if (c->def->callback == get_cmd_any) {
+	    result = ucl_object_frombool(c->seen > 0);
+	    output_chunk(result, nodepath.buf, "");
+	    ucl_object_unref(result);
+	} else if (c->def->callback == get_cmd_exists && c->seen == 0) {
+	    status = 1;
+	}
+    }
+
+    strbuf_free(&nodepath);
+    strbuf_free(&keybuf);
+    strbuf_free(&aggkey);
+    arena_reset(&scratch);
+
+    return(status);
+}
+
+void
+get_mode(char *requested_node)
+{
+    get_plan_t *plan = NULL;
+    const ucl_object_t *found = NULL;
+
+    plan = get_compile(requested_node);
+    get_resolve(&plan, 1, &found);
+    get_run(plan, found);
+    get_plan_free(plan);
+}
+
+/*
+ * The level the last command of the chain starting at cmd runs at. A
+ * command that passes nothing on returns this rather than its own level,
+ * so get_run() does not go on to run the rest of the chain on the
+ * original node.
+ */
+static int
+get_chain_depth(const get_cmd_t *cmd, int recurse)
+{
+    for (cmd = cmd->next; cmd != NULL; cmd = cmd->next) {
+	recurse++;
+    }
+    return recurse;
+}
+
+int
+process_get_command(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse)
+{
+    int recurse_level = recurse;
+
+    if (debug >= 2) {
+	fprintf(stderr, "DEBUG: Got command: %s - next command: %s\n",
+	    cmd->str, cmd->next != NULL ? cmd->next->str : "(null)");
+    }
+    recurse_level = cmd->def->callback(obj, nodepath, cmd, recurse_level);
+    if (debug >= 3) {
+	fprintf(stderr, "DEBUG: Returning p_g_c with rlevel=%i\n",
+	    recurse_level);
+    }
+    return recurse_level;
+}
+
+/*
+ * Dump the internal representation of the current object
+ */
+int
+get_cmd_dump(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse)
+{
+    ucl_obj_dump(obj, 2);
+
+    return(recurse);
+}
+
+/*
+ * Return the number of keys in an object or items in an array
+ */
+int
+get_cmd_length(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse)
+{
+    ucl_object_t *len = NULL;
+
+    if (output_type == OUTPUT_NDJSON) {
+	len = ucl_object_fromint(obj != NULL ? obj->len : 0);
+	output_chunk(len, nodepath->buf, "");
+	ucl_object_unref(len);
+	return recurse;
+    }
+    output_record_start(true);
+    if (obj == NULL) {
+	if (show_keys == 1)
+	    output_puts("(null)=");
+	output_putc('0');
+    } else {
+	if (show_keys == 1)
+	    output_puts(nodepath->buf);
+	output_int(obj->len);
+    }
+    output_record_end();
+
+    return recurse;
+}
+
+/*
+ * The value an aggregate or group_by works on: the one at its path, or the
+ * incoming value itself
+ */
+static const ucl_object_t*
+agg_value(const get_cmd_t *cmd, const ucl_object_t *obj)
+{
+    if (cmd->npaths == 0 || cmd->paths[0].nsegs == 0) {
+	return obj;
+    }
+    return keypath_lookup(obj, &cmd->paths[0]);
+}
+
+/*
+ * Build the canonical text of val in aggkey, prefixed with a letter for its
+ * type so that 1 and "1" are not the same value
+ */
+static void
+agg_key(const ucl_object_t *val)
+{
+    unsigned char *json = NULL;
+    const char *str = NULL;
+    char num[64];
+    size_t len;
+
+    strbuf_truncate(&aggkey, 0);
+    strbuf_addc(&aggkey, 'a' + ucl_object_type(val));
+    switch (ucl_object_type(val)) {
+    case UCL_STRING:
+	str = ucl_object_tolstring(val, &len);
+	strbuf_addn(&aggkey, str, len);
+	break;
+    case UCL_INT:
+	snprintf(num, sizeof(num), "%jd", (intmax_t)ucl_object_toint(val));
+	strbuf_adds(&aggkey, num);
+	break;
+    case UCL_FLOAT:
+    case UCL_TIME:
+	snprintf(num, sizeof(num), "%.17g", ucl_object_todouble(val));
+	strbuf_adds(&aggkey, num);
+	break;
+    case UCL_BOOLEAN:
+	strbuf_adds(&aggkey, ucl_object_toboolean(val) ? "true" : "false");
+	break;
+    case UCL_NULL:
+	strbuf_adds(&aggkey, "null");
+	break;
+    case UCL_OBJECT:
+    case UCL_ARRAY:
+	json = ucl_object_emit(val, UCL_EMIT_JSON_COMPACT);
+	strbuf_adds(&aggkey, (const char *)json);
+	free(json);
+	break;
+    default:
+	break;
+    }
+}
+
+/*
+ * Find the entry for the current aggkey in set, adding it if this is the
+ * first time it is seen. Entries live in the scratch arena for the run.
+ */
+static agg_entry_t*
+agg_set_add(agg_set_t *set, bool *added)
+{
+    agg_entry_t *ent = NULL;
+    uint64_t hash;
+    size_t b;
+
+    hash = hash_bytes(aggkey.buf, aggkey.len, HASH_SEED);
+    *added = false;
+    if (set->buckets != NULL) {
+	for (ent = set->buckets[hash & (set->size - 1)]; ent != NULL;
+	    ent = ent->next) {
+	    if (ent->hash == hash && ent->len == aggkey.len &&
+		memcmp(ent->key, aggkey.buf, aggkey.len) == 0) {
+		return ent;
+	    }
+	}
+    }
+
+    if (set->count >= set->size) {
+	set->size = set->size ? set->size * 2 : 64;
+	set->buckets = arena_calloc(&scratch, set->size,
+	    sizeof(*set->buckets));
+	for (ent = set->first; ent != NULL; ent = ent->order) {
+	    b = ent->hash & (set->size - 1);
+	    ent->next = set->buckets[b];
+	    set->buckets[b] = ent;
+	}
+    }
+    ent = arena_calloc(&scratch, 1, sizeof(*ent));
+    /* The key may hold NULs, from the raw bytes of a string value */
+    ent->key = arena_alloc(&scratch, aggkey.len + 1);
+    memcpy(ent->key, aggkey.buf, aggkey.len + 1);
+    ent->len = aggkey.len;
+    ent->hash = hash;
+    b = hash & (set->size - 1);
+    ent->next = set->buckets[b];
+    set->buckets[b] = ent;
+    if (set->last == NULL) {
+	set->last = &set->first;
+    }
+    *set->last = ent;
+    set->last = &ent->order;
+    set->count++;
+    *added = true;
+
+    return ent;
+}
+
+static int
+agg_cmp(const ucl_object_t *a, const ucl_object_t *b)
+{
+    int64_t ia, ib;
+    double da, db;
+
+    if (ucl_object_type(a) == UCL_INT && ucl_object_type(b) == UCL_INT) {
+	ia = ucl_object_toint(a);
+	ib = ucl_object_toint(b);
+	return (ia > ib) - (ia < ib);
+    }
+    da = ucl_object_todouble(a);
+    db = ucl_object_todouble(b);
+    return (da > db) - (da < db);
+}
+
+/*
+ * Fold obj into the state of aggregate cmd. Only numbers are summed,
+ * averaged and compared. distinct outputs each new value right away
+ * unless it is grouped, in which case nodepath is NULL.
+ */
+static void
+agg_add(const get_cmd_t *cmd, get_agg_t *agg, const ucl_object_t *obj,
+    strbuf_t *nodepath)
+{
+    const ucl_object_t *val = agg_value(cmd, obj);
+    get_cmd_func_t cb = cmd->def->callback;
+    agg_entry_t *ent = NULL;
+    bool added;
+
+    if (cb == get_cmd_count) {
+	if (cmd->npaths == 0 || val != NULL) {
+	    agg->count++;
+	}
+	return;
+    }
+    if (cb == get_cmd_distinct) {
+	/* Like count, distinct skips values the path does not find */
+	if (val == NULL) {
+	    return;
+	}
+	if (agg->distinct == NULL) {
+	    agg->distinct = arena_calloc(&scratch, 1, sizeof(*agg->distinct));
+	}
+	agg_key(val);
+	ent = agg_set_add(agg->distinct, &added);
+	if (added) {
+	    ent->obj = val;
+	    if (nodepath != NULL) {
+		output_chunk(val, nodepath->buf, "");
+	    }
+	}
+	return;
+    }
+
+    switch (ucl_object_type(val)) {
+    case UCL_INT:
+	agg->isum += ucl_object_toint(val);
+	agg->dsum += ucl_object_toint(val);
+	break;
+    case UCL_FLOAT:
+    case UCL_TIME:
+	agg->is_float = true;
+	agg->dsum += ucl_object_todouble(val);
+	break;
+    default:
+	return;
+    }
+    agg->nums++;
+    if (agg->min == NULL || agg_cmp(val, agg->min) < 0) {
+	agg->min = val;
+    }
+    if (agg->max == NULL || agg_cmp(val, agg->max) > 0) {
+	agg->max = val;
+    }
+}
+
+/*
+ * Output the result of aggregate cmd, agg is NULL if no value reached it
+ */
+static void
+agg_output(const get_cmd_t *cmd, const get_agg_t *agg, const char *nodepath,
+    const char *key, bool grouped)
+{
+    get_cmd_func_t cb = cmd->def->callback;
+    const agg_entry_t *ent = NULL;
+    ucl_object_t *result = NULL;
+    get_agg_t empty;
+
+    if (agg == NULL) {
+	memset(&empty, 0, sizeof(empty));
+	agg = &empty;
+    }
+    if (cb == get_cmd_distinct) {
+	/* Ungrouped values were output as they were found */
+	if (grouped && agg->distinct != NULL) {
+	    for (ent = agg->distinct->first; ent != NULL; ent = ent->order) {
+		output_chunk(ent->obj, nodepath, key);
+	    }
+	}
+	return;
+    }
+    if (cb == get_cmd_min || cb == get_cmd_max) {
+	output_chunk(cb == get_cmd_min ? agg->min : agg->max, nodepath, key);
+	return;
+    }
+
+    if (cb == get_cmd_count) {
+	result = ucl_object_fromint(agg->count);
+    } else if (cb == get_cmd_sum) {
+	result = agg->is_float ? ucl_object_fromdouble(agg->dsum) :
+	    ucl_object_fromint(agg->isum);
+    } else if (cb == get_cmd_avg && agg->nums > 0) {
+	result = ucl_object_fromdouble(agg->dsum / agg->nums);
+    }
+    output_chunk(result, nodepath, key);
+    if (result != NULL) {
+	ucl_object_unref(result);
+    }
+}
+
+/*
+ * Reduce the values reaching an aggregate into its running state, see
+ * agg_add(). The result is output by get_run() at the end.
+ */
+static int
+get_cmd_agg(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse)
+{
+    get_cmd_t *state = __DECONST(get_cmd_t *, cmd);
+
+    if (state->agg == NULL) {
+	state->agg = arena_calloc(&scratch, 1, sizeof(*state->agg));
+    }
+    agg_add(cmd, state->agg, obj, nodepath);
+
+    return(recurse);
+}
+
+int
+get_cmd_count(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse)
+{
+    return get_cmd_agg(obj, nodepath, cmd, recurse);
+}
+
+int
+get_cmd_sum(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse)
+{
+    return get_cmd_agg(obj, nodepath, cmd, recurse);
+}
+
+int
+get_cmd_min(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse)
+{
+    return get_cmd_agg(obj, nodepath, cmd, recurse);
+}
+
+int
+get_cmd_max(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse)
+{
+    return get_cmd_agg(obj, nodepath, cmd, recurse);
+}
+
+int
+get_cmd_avg(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse)
+{
+    return get_cmd_agg(obj, nodepath, cmd, recurse);
+}
+
+int
+get_cmd_distinct(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse)
+{
+    return get_cmd_agg(obj, nodepath, cmd, recurse);
+}
+
+/*
+ * Sort values into groups by the value at the path, and fold each into
+ * its group's state of the aggregate that follows
+ */
+int
+get_cmd_group_by(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse)
+{
+    get_cmd_t *state = __DECONST(get_cmd_t *, cmd);
+    const ucl_object_t *val = agg_value(cmd, obj);
+    agg_entry_t *ent = NULL;
+    bool added;
+
+    /*
+     * Like count and distinct, values the path does not find are skipped,
+     * rather than put in the group of an explicit null
+     */
+    if (val == NULL) {
+	return(recurse + 1);
+    }
+    if (state->groups == NULL) {
+	state->groups = arena_calloc(&scratch, 1, sizeof(*state->groups));
+    }
+    agg_key(val);
+    ent = agg_set_add(state->groups, &added);
+    if (ent->agg == NULL) {
+	ent->agg = arena_calloc(&scratch, 1, sizeof(*ent->agg));
+    }
+    agg_add(cmd->next, ent->agg, obj, NULL);
+
+    return(recurse + 1);
+}
+
+/*
+ * Return the type of the current object
+ */
+int
+get_cmd_type(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse)
+{
+    const char *type = "null";
+    ucl_object_t *typestr = NULL;
+
+    if (obj != NULL) {
+	switch(ucl_object_type(obj)) {
+	case UCL_OBJECT:
+	    type = "object";
+	    break;
+	case UCL_ARRAY:
+	    type = "array";
+	    break;
+	case UCL_INT:
+	    type = "int";
+	    break;
+	case UCL_FLOAT:
+	    type = "float";
+	    break;
+	case UCL_STRING:
+	    type = "string";
 	    break;
 	case UCL_BOOLEAN:
-	    printf("boolean");
+	    type = "boolean";
 	    break;
 	case UCL_TIME:
-	    printf("time");
+	    type = "time";
 	    break;
 	case UCL_USERDATA:
-	    printf("userdata");
+	    type = "userdata";
 	    break;
 	case UCL_NULL:
-	    printf("null");
+	    type = "null";
 	    break;
 	default:
-	    printf("unknown");
+	    type = "unknown";
 	    break;
 	}
     }
-    if (nonewline) {
-	firstline = false;
-    } else {
-	printf("\n");
+    if (output_type == OUTPUT_NDJSON) {
+	typestr = ucl_object_fromstring(type);
+	output_chunk(typestr, nodepath->buf, "");
+	ucl_object_unref(typestr);
+	return(recurse);
+    }
+
+    output_record_start(true);
+    if (obj == NULL) {
+	if (show_keys == 1)
+	    output_puts("(null)=");
+    } else if (show_keys == 1) {
+	output_puts(nodepath->buf);
+	output_putc('=');
     }
+    output_puts(type);
+    output_record_end();
 
     return(recurse);
 }
@@ -357,256 +1612,499 @@ get_cmd_type(const ucl_object_t *obj, char *nodepath,
  * Return the keys of the current object
  */
 int
-get_cmd_keys(const ucl_object_t *obj, char *nodepath,
-    const char *command_str, char *remaining_commands, int recurse)
+get_cmd_keys(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse)
 {
     ucl_object_iter_t it = NULL;
     const ucl_object_t *cur;
+    ucl_object_t *keystr = NULL;
     int loopcount = 0;
 
     if (obj != NULL) {
 	while ((cur = ucl_iterate_object(obj, &it, true))) {
-	    if (firstline == false) {
-		printf(" ");
+	    if (output_type == OUTPUT_NDJSON) {
+		keystr = ucl_object_fromstring(ucl_object_key(cur));
+		output_chunk(keystr, nodepath->buf, "");
+		ucl_object_unref(keystr);
+		loopcount++;
+		continue;
+	    }
+	    output_record_start(true);
+	    output_puts(ucl_object_key(cur) != NULL ? ucl_object_key(cur) :
+		"(null)");
+	    output_record_end();
+	    loopcount++;
+	}
+    }
+    if (loopcount == 0 && debug > 0) {
+	fprintf(stderr, "DEBUG: Found 0 keys\n");
+    }
+
+    return(recurse);
+}
+
+/*
+ * Return the values of each key in the current object
+ */
+int
+get_cmd_values(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse)
+{
+    ucl_object_iter_t it = NULL;
+    const ucl_object_t *cur;
+    int loopcount = 0, arrindex = 0;
+    const char *newkey = NULL;
+
+    if (obj != NULL) {
+	while ((cur = ucl_iterate_object(obj, &it, true))) {
+	    if (cur == NULL) {
+		continue;
 	    }
-	    printf("%s", ucl_object_key(cur));
-	    if (nonewline) {
-		firstline = false;
+	    if (ucl_object_type(obj) == UCL_ARRAY) {
+		newkey = child_key(obj, cur, arrindex);
+		arrindex++;
+	    } else if (ucl_object_key(cur) != NULL) {
+		newkey = child_key(obj, cur, arrindex);
 	    } else {
-		printf("\n");
+		newkey = NULL;
 	    }
+	    output_key(cur, nodepath->buf, newkey);
 	    loopcount++;
 	}
     }
     if (loopcount == 0 && debug > 0) {
-	fprintf(stderr, "DEBUG: Found 0 keys\n");
+	fprintf(stderr, "DEBUG: Found 0 values\n");
     }
 
-    return(recurse);
+    return(recurse);
+}
+
+/*
+ * Iterate over each key in the object
+ */
+int
+get_cmd_iterate(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse)
+{
+    ucl_object_iter_t it = NULL;
+    const ucl_object_t *cur;
+    int recurse_level = recurse;
+    int loopcount = 0;
+
+    if (cmd->next == NULL) {
+	it = NULL;
+	char blankkey = '\0';
+	while ((cur = ucl_iterate_object(obj, &it, false))) {
+	    output_chunk(cur, nodepath->buf, &blankkey);
+	    loopcount++;
+	}
+    } else if (obj != NULL) {
+	/* Return the values of the current object */
+	it = NULL;
+	while (!halted && (cur = ucl_iterate_object(obj, &it, false))) {
+	    recurse_level = process_get_command(cur, nodepath, cmd->next,
+		recurse + 1);
+	}
+	loopcount++;
+    }
+    if (loopcount == 0 && debug > 0) {
+	fprintf(stderr, "DEBUG: Found 0 objects to each over\n");
+    }
+
+    return(recurse_level);
+}
+
+/*
+ * Print the lines recurse outputs for a node itself, before its children
+ */
+static void
+recurse_node(const ucl_object_t *obj, strbuf_t *nodepath)
+{
+    char tmpkeyname[16];
+
+    if (nodepath->len > 0) {
+	output_chunk(obj, nodepath->buf, "");
+	if (expand && ucl_object_type(obj) == UCL_ARRAY) {
+	    ucl_object_t *arrlen = NULL;
+
+	    arrlen = ucl_object_fromint(obj->len);
+	    snprintf(tmpkeyname, sizeof(tmpkeyname), "%c%s", output_sepchar,
+		"_length");
+	    output_chunk(arrlen, nodepath->buf, tmpkeyname);
+	    ucl_object_unref(arrlen);
+	}
+    }
+    if (expand && ucl_object_type(obj) == UCL_OBJECT) {
+	arena_mark_t mark = arena_mark(&scratch);
+	char *keylist = NULL;
+	ucl_object_t *keystr = NULL;
+
+	keylist = expand_subkeys(&scratch, obj);
+	keystr = ucl_object_fromstring(keylist);
+	snprintf(tmpkeyname, sizeof(tmpkeyname), "%c%s", output_sepchar,
+	    "_keys");
+	output_chunk(keystr, nodepath->buf, tmpkeyname);
+	ucl_object_unref(keystr);
+	arena_release(&scratch, mark);
+    }
+}
+
+/*
+ * Print scalar child cur of obj, the way recurse outputs every leaf
+ */
+static void
+recurse_leaf(const ucl_object_t *obj, const ucl_object_t *cur,
+    strbuf_t *nodepath, int curindex)
+{
+    const char *newkey = NULL;
+
+    if (ucl_object_type(obj) != UCL_ARRAY && nodepath->len == 0) {
+	newkey = ucl_object_key(cur);
+    } else {
+	newkey = child_key(obj, cur, curindex);
+    }
+    output_chunk(cur, nodepath->buf, newkey);
+}
+
+/*
+ * Append the path segment recurse uses for cur2, an element of the
+ * implicit chain of container child cur of obj
+ */
+static void
+recurse_segment(strbuf_t *nodepath, const ucl_object_t *obj,
+    const ucl_object_t *cur, const ucl_object_t *cur2, int curindex,
+    int arrindex)
+{
+    if (nodepath->len > 0) {
+	push_child(nodepath, obj, cur, curindex);
+    } else if (ucl_object_type(obj) == UCL_ARRAY) {
+	/* Historically numbered from 1 at the top level */
+	strbuf_addi(nodepath, arrindex);
+    } else {
+	strbuf_adds(nodepath, ucl_object_key(cur2));
+    }
+}
+
+/*
+ * Output everything below obj, whose own lines have already been printed
+ *
+ * The walk is iterative, one walk_frame_t per level, so the nesting depth
+ * is not limited by the C stack. Each frame's ret is what the recursive
+ * version returned for that node: the result of its last container child,
+ * or its own level if it has none.
+ */
+static int
+recurse_walk(const ucl_object_t *obj, strbuf_t *nodepath, int recurse)
+{
+    walk_t walk;
+    walk_frame_t *frame = NULL;
+    const ucl_object_t *cur, *cur2;
+    size_t pathlen = nodepath->len;
+    int recurse_level = recurse, ret;
+
+    memset(&walk, 0, sizeof(walk));
+    frame = walk_push(&walk, obj);
+    frame->pathlen = nodepath->len;
+    frame->level = frame->ret = recurse;
+
+    while (walk.depth > 0) {
+	frame = &walk.frames[walk.depth - 1];
+	strbuf_truncate(nodepath, frame->pathlen);
+	if (frame->chain == NULL) {
+	    cur = ucl_iterate_object(frame->obj, &frame->it, true);
+	    if (cur == NULL) {
+		if (frame->count == 0 && debug > 0) {
+		    fprintf(stderr, "DEBUG: Found 0 objects to each over\n");
+		}
+		ret = frame->ret;
+		walk_pop(&walk);
+		if (walk.depth > 0) {
+		    walk.frames[walk.depth - 1].ret = ret;
+		} else {
+		    recurse_level = ret;
+		}
+		continue;
+	    }
+	    frame->count++;
+	    frame->curindex = frame->arrindex;
+	    if (ucl_object_type(frame->obj) == UCL_ARRAY) {
+		frame->arrindex++;
+	    }
+	    if (ucl_object_type(cur) != UCL_OBJECT &&
+		    ucl_object_type(cur) != UCL_ARRAY) {
+		recurse_leaf(frame->obj, cur, nodepath, frame->curindex);
+		continue;
+	    }
+	    frame->cur = frame->chain = cur;
+	}
+
+	/* Descend into the next element of the container's implicit chain */
+	cur2 = frame->chain;
+	frame->chain = cur2->next;
+	recurse_segment(nodepath, frame->obj, frame->cur, cur2,
+	    frame->curindex, frame->arrindex);
+	ret = frame->level + 1;
+	recurse_node(cur2, nodepath);
+	frame = walk_push(&walk, cur2);
+	frame->pathlen = nodepath->len;
+	frame->level = frame->ret = ret;
+    }
+
+    strbuf_truncate(nodepath, pathlen);
+    walk_free(&walk);
+
+    return(recurse_level);
+}
+
+/*
+ * Output one task of a parallel recurse, exactly as recurse_walk() would
+ * have output that part of the tree. Runs on a worker thread.
+ */
+static void
+recurse_job(void *ctx, size_t index)
+{
+    recurse_split_t *split = ctx;
+    recurse_task_t *task = &split->tasks[index];
+    strbuf_t nodepath;
+
+    strbuf_init(&nodepath, task->path);
+    strbuf_init(&keybuf, NULL);
+    if (task->cur2 == NULL) {
+	recurse_leaf(task->obj, task->cur, &nodepath, task->curindex);
+    } else {
+	recurse_segment(&nodepath, task->obj, task->cur, task->cur2,
+	    task->curindex, task->arrindex);
+	recurse_node(task->cur2, &nodepath);
+	if (task->subpath == NULL) {
+	    task->ret = recurse_walk(task->cur2, &nodepath, task->level + 1);
+	}
+    }
+    strbuf_free(&keybuf);
+    strbuf_free(&nodepath);
+}
+
+static void
+recurse_split_free(recurse_split_t *split)
+{
+    size_t i;
+
+    for (i = 0; i < split->ntasks; i++) {
+	free(split->tasks[i].subpath);
+    }
+    free(split->tasks);
+    memset(split, 0, sizeof(*split));
 }
 
 /*
- * Return the values of each key in the current object
+ * Append the tasks for the children of obj, whose task is parent, to
+ * split. A container child gets a task per element of its implicit chain.
+ * While depth is above 1, a container with children of its own is split
+ * further: its task outputs only its own lines and its children are added
+ * after it. Returns false if out of memory.
  */
-int
-get_cmd_values(const ucl_object_t *obj, char *nodepath,
-    const char *command_str, char *remaining_commands, int recurse)
+static bool
+recurse_split_add(recurse_split_t *split, const ucl_object_t *obj,
+    const char *path, int level, size_t parent, int depth)
 {
     ucl_object_iter_t it = NULL;
-    const ucl_object_t *cur;
-    int loopcount = 0, arrindex = 0;
-    char *newkey = NULL;
+    const ucl_object_t *cur, *cur2;
+    recurse_task_t *task, *tmp;
+    strbuf_t subpath;
+    size_t index;
+    int arrindex = 0, curindex;
 
-    if (obj != NULL) {
-	while ((cur = ucl_iterate_object(obj, &it, true))) {
-	    if (cur == NULL) {
+    while ((cur = ucl_iterate_object(obj, &it, true))) {
+	curindex = arrindex;
+	if (ucl_object_type(obj) == UCL_ARRAY) {
+	    arrindex++;
+	}
+	cur2 = cur;
+	do {
+	    if (split->ntasks == split->size) {
+		split->size = split->size ? split->size * 2 : 64;
+		tmp = realloc(split->tasks,
+		    split->size * sizeof(*split->tasks));
+		if (tmp == NULL) {
+		    return false;
+		}
+		split->tasks = tmp;
+	    }
+	    index = split->ntasks++;
+	    task = &split->tasks[index];
+	    memset(task, 0, sizeof(*task));
+	    task->obj = obj;
+	    task->cur = cur;
+	    task->path = path;
+	    task->curindex = curindex;
+	    task->arrindex = arrindex;
+	    task->level = level;
+	    task->parent = parent;
+	    if (ucl_object_type(cur) != UCL_OBJECT &&
+		ucl_object_type(cur) != UCL_ARRAY) {
+		break;
+	    }
+	    task->cur2 = cur2;
+	    task->ret = level + 1;
+	    if (depth <= 1 || cur2->len == 0) {
 		continue;
 	    }
-	    if (ucl_object_type(obj) == UCL_ARRAY) {
-		asprintf(&newkey, "%c%i", output_sepchar, arrindex);
-		arrindex++;
-	    } else {
-		newkey = __DECONST(char *, ucl_object_key(cur));
-		if (newkey != NULL) {
-		    asprintf(&newkey, "%c%s", output_sepchar, ucl_object_key(cur));
-		}
+	    strbuf_init(&subpath, path);
+	    recurse_segment(&subpath, obj, cur, cur2, curindex, arrindex);
+	    task->subpath = subpath.buf;
+	    if (!recurse_split_add(split, cur2, task->subpath, level + 1,
+		index, depth - 1)) {
+		return false;
 	    }
-	    output_key(cur, nodepath, newkey);
-	    loopcount++;
-	    free(newkey);
-	    newkey = NULL;
-	}
-    }
-    if (loopcount == 0 && debug > 0) {
-	fprintf(stderr, "DEBUG: Found 0 values\n");
+	} while ((cur2 = cur2->next) != NULL);
     }
 
-    return(recurse);
+    return true;
 }
 
 /*
- * Iterate over each key in the object
+ * Split the walk below obj into tasks and hand them to jobs_run(). The
+ * tasks cover disjoint parts of the tree, so the workers never touch the
+ * same object, and their output is stitched back in tree order.
+ *
+ * Splitting only at obj's children leaves the other threads idle when obj
+ * has a single big child, so the split goes down a level at a time until
+ * there are RECURSE_TASKS_PER_JOB tasks for each thread, or the tree
+ * stops growing wider.
  */
-int
-get_cmd_iterate(const ucl_object_t *obj, char *nodepath,
-    const char *command_str, char *remaining_commands, int recurse)
+static int
+recurse_parallel(const ucl_object_t *obj, strbuf_t *nodepath, int recurse)
 {
-    ucl_object_iter_t it = NULL;
-    const ucl_object_t *cur;
-    int recurse_level = recurse;
-    int loopcount = 0;
+    recurse_split_t split;
+    recurse_task_t *task;
+    size_t want, last = 0, i;
+    int depth, recurse_level = recurse;
+    bool settled = false;
 
-    if (remaining_commands == NULL) {
-	it = NULL;
-	char blankkey = '\0';
-	while ((cur = ucl_iterate_object(obj, &it, false))) {
-	    output_chunk(cur, nodepath, &blankkey);
-	    loopcount++;
+    want = (size_t)jobs * RECURSE_TASKS_PER_JOB;
+    memset(&split, 0, sizeof(split));
+    for (depth = 1; depth <= RECURSE_SPLIT_DEPTH; depth++) {
+	recurse_split_free(&split);
+	if (!recurse_split_add(&split, obj, nodepath->buf, recurse,
+	    SIZE_MAX, depth)) {
+	    recurse_split_free(&split);
+	    return recurse_walk(obj, nodepath, recurse);
 	}
-    } else if (obj != NULL) {
-	/* Return the values of the current object */
-	char *rcmds = strdup(remaining_commands);
-	char *next_command = strsep(&rcmds, "|");
-	if (next_command != NULL) {
-	    it = NULL;
-	    while ((cur = ucl_iterate_object(obj, &it, false))) {
-		recurse_level = process_get_command(cur, nodepath,
-		    next_command, rcmds, recurse + 1);
-	    }
-	    loopcount++;
+	if (split.ntasks >= want || split.ntasks == last) {
+	    break;
 	}
+	last = split.ntasks;
     }
-    if (loopcount == 0 && debug > 0) {
-	fprintf(stderr, "DEBUG: Found 0 objects to each over\n");
+    if (debug > 0) {
+	fprintf(stderr, "DEBUG: Split recurse into %zu tasks\n",
+	    split.ntasks);
+    }
+    if (split.ntasks < 2 || !jobs_run(split.ntasks, recurse_job, &split)) {
+	recurse_split_free(&split);
+	return recurse_walk(obj, nodepath, recurse);
+    }
+
+    /*
+     * A container's level is that of its last container child, as in
+     * recurse_walk(). Children come after their parent's task, so walking
+     * backwards meets a node's last child first, and has settled the
+     * node's own level before it is passed on.
+     */
+    for (i = split.ntasks; i-- > 0;) {
+	task = &split.tasks[i];
+	if (task->cur2 == NULL) {
+	    continue;
+	}
+	if (task->parent == SIZE_MAX) {
+	    if (!settled) {
+		recurse_level = task->ret;
+		settled = true;
+	    }
+	} else if (!split.tasks[task->parent].settled) {
+	    split.tasks[task->parent].ret = task->ret;
+	    split.tasks[task->parent].settled = true;
+	}
     }
+    recurse_split_free(&split);
 
     return(recurse_level);
 }
 
 /*
  * Recurse through and output every key
+ *
+ * With --jobs the subtrees below obj are formatted in parallel. That is
+ * skipped for --nonewline, where whether a line needs a separator depends
+ * on everything that was printed before it.
  */
 int
-get_cmd_recurse(const ucl_object_t *obj, char *nodepath,
-    const char *command_str, char *remaining_commands, int recurse)
+get_cmd_recurse(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse)
 {
-    ucl_object_iter_t it = NULL, it2 = NULL;
-    const ucl_object_t *cur, *cur2;
-    char *tmpkeyname = NULL;
-    int recurse_level = recurse;
-    int loopcount = 0, arrindex = 0;
-
-    if (strlen(nodepath) > 0) {
-	output_chunk(obj, nodepath, "");
-	if (expand && ucl_object_type(obj) == UCL_ARRAY) {
-	    ucl_object_t *arrlen = NULL;
-
-	    arrlen = ucl_object_fromint(obj->len);
-	    asprintf(&tmpkeyname, "%c%s", output_sepchar, "_length");
-	    output_chunk(arrlen, nodepath, tmpkeyname);
-	    free(tmpkeyname);
-	}
-    }
-    if (expand && ucl_object_type(obj) == UCL_OBJECT) {
-	char *keylist = NULL;
-	ucl_object_t *keystr = NULL;
-
-	keylist = expand_subkeys(obj, nodepath);
-	if (keylist != NULL) {
-	    keystr = ucl_object_fromstring(keylist);
-	    asprintf(&tmpkeyname, "%c%s", output_sepchar, "_keys");
-	    output_chunk(keystr, nodepath, tmpkeyname);
-	    free(tmpkeyname);
-	    free(keylist);
-	}
-    }
-    it = NULL;
-    while ((cur = ucl_iterate_object(obj, &it, true))) {
-	char *newkey = NULL;
-	char *newnodepath = NULL;
-	if (ucl_object_type(obj) == UCL_ARRAY) {
-	    asprintf(&newkey, "%c%i", output_sepchar, arrindex);
-	    arrindex++;
-	} else if (strlen(nodepath) == 0) {
-	    asprintf(&newkey, "%s", ucl_object_key(cur));
-	} else {
-	    asprintf(&newkey, "%c%s", output_sepchar, ucl_object_key(cur));
-	}
-	if (ucl_object_type(cur) == UCL_OBJECT ||
-		ucl_object_type(cur) == UCL_ARRAY) {
-	    it2 = NULL;
-	    while ((cur2 = ucl_iterate_object(cur, &it2, false))) {
-		if (nodepath != NULL && strlen(nodepath) > 0) {
-		    asprintf(&newnodepath, "%s%s", nodepath, newkey);
-		} else {
-		    if (ucl_object_type(obj) == UCL_ARRAY) {
-			asprintf(&newnodepath, "%i", arrindex);
-		    } else {
-			asprintf(&newnodepath, "%s", ucl_object_key(cur2));
-		    }
-		}
-		recurse_level = process_get_command(cur2,
-		    newnodepath, command_str, remaining_commands,
-		    recurse + 1);
-	    }
-	} else {
-	    output_chunk(cur, nodepath, newkey);
-	}
-	loopcount++;
-	free(newkey);
-	free(newnodepath);
+    recurse_node(obj, nodepath);
+    if (jobs > 1 && !nonewline && (ucl_object_type(obj) == UCL_OBJECT ||
+	ucl_object_type(obj) == UCL_ARRAY)) {
+	return recurse_parallel(obj, nodepath, recurse);
     }
-    if (loopcount == 0 && debug > 0) {
-	fprintf(stderr, "DEBUG: Found 0 objects to each over\n");
-    }
-
-    return(recurse_level);
+    return recurse_walk(obj, nodepath, recurse);
 }
 
 /*
  * Loop over each object and perform the next command on it
  */
 int
-get_cmd_each(const ucl_object_t *obj, char *nodepath,
-    const char *command_str, char *remaining_commands, int recurse)
+get_cmd_each(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse)
 {
     ucl_object_iter_t it = NULL, it2 = NULL;
     const ucl_object_t *cur, *cur2;
+    const char *newkey = NULL;
+    size_t pathlen;
     int recurse_level = recurse;
     int loopcount = 0, arrindex = 0;
 
-    if (remaining_commands == NULL) {
+    if (cmd->next == NULL) {
 	it = NULL;
 	while ((cur = ucl_iterate_object(obj, &it, true))) {
-	    char *newkey = NULL;
+	    newkey = child_key(obj, cur, arrindex);
 	    if (ucl_object_type(obj) == UCL_ARRAY) {
-		asprintf(&newkey, "%c%i", output_sepchar, arrindex);
 		arrindex++;
-	    } else {
-		asprintf(&newkey, "%c%s", output_sepchar, ucl_object_key(cur));
 	    }
 	    if (cur->next != 0 && cur->type != UCL_ARRAY) {
 		/* Implicit array */
 		it2 = NULL;
 		while ((cur2 = ucl_iterate_object(cur, &it2, false))) {
-		    output_chunk(cur2, nodepath, newkey);
+		    output_chunk(cur2, nodepath->buf, newkey);
 		}
 	    } else {
-		output_chunk(cur, nodepath, newkey);
+		output_chunk(cur, nodepath->buf, newkey);
 	    }
 	    loopcount++;
-	    free(newkey);
 	}
     } else if (obj != NULL) {
 	/* Return the values of the current object */
-	char *rcmds = strdup(remaining_commands);
-	char *next_command = strsep(&rcmds, "|");
-	if (next_command != NULL) {
-	    it = NULL;
-	    while ((cur = ucl_iterate_object(obj, &it, true))) {
-		char *newnodepath = NULL;
-		if (ucl_object_type(obj) == UCL_ARRAY) {
-		    asprintf(&newnodepath, "%s%c%i", nodepath, output_sepchar,
-			arrindex);
-		    arrindex++;
-		} else {
-		    asprintf(&newnodepath, "%s%c%s", nodepath, output_sepchar,
-			ucl_object_key(cur));
-		}
-		if (cur->next != 0 && cur->type != UCL_ARRAY) {
-		    /* Implicit array */
-		    it2 = NULL;
-		    while ((cur2 = ucl_iterate_object(cur, &it2, false))) {
-			recurse_level = process_get_command(cur2,
-			    newnodepath, next_command, rcmds, recurse + 1);
-		    }
-		} else {
-		    recurse_level = process_get_command(cur, newnodepath,
-			next_command, rcmds, recurse + 1);
+	it = NULL;
+	while (!halted && (cur = ucl_iterate_object(obj, &it, true))) {
+	    pathlen = push_child(nodepath, obj, cur, arrindex);
+	    if (ucl_object_type(obj) == UCL_ARRAY) {
+		arrindex++;
+	    }
+	    if (cur->next != 0 && cur->type != UCL_ARRAY) {
+		/* Implicit array */
+		it2 = NULL;
+		while (!halted &&
+		    (cur2 = ucl_iterate_object(cur, &it2, false))) {
+		    recurse_level = process_get_command(cur2,
+			nodepath, cmd->next, recurse + 1);
 		}
-		loopcount++;
-		free(newnodepath);
+	    } else {
+		recurse_level = process_get_command(cur, nodepath,
+		    cmd->next, recurse + 1);
 	    }
+	    strbuf_truncate(nodepath, pathlen);
+	    loopcount++;
+	}
+	if (loopcount == 0) {
+	    recurse_level = get_chain_depth(cmd, recurse);
 	}
     }
     if (loopcount == 0 && debug > 0) {
@@ -616,63 +2114,453 @@ get_cmd_each(const ucl_object_t *obj, char *nodepath,
     return(recurse_level);
 }
 
+/*
+ * Like each, but only over the elements of an array that a slice selects.
+ * They are found by index, so the rest of the array is never visited.
+ */
+int
+get_cmd_slice(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse)
+{
+    const keyseg_t *seg = &cmd->paths[0].segs[0];
+    const ucl_object_t *cur;
+    size_t pathlen, count = 0, i;
+    int recurse_level = recurse;
+    long first, index;
+
+    if (ucl_object_type(obj) == UCL_ARRAY) {
+	count = keyseg_slice(seg, obj->len, &first);
+    }
+    for (i = 0; i < count && !halted; i++) {
+	index = first + (long)i * seg->step;
+	cur = ucl_array_find_index(obj, index);
+	if (cmd->next == NULL) {
+	    output_chunk(cur, nodepath->buf, child_key(obj, cur, index));
+	} else {
+	    pathlen = push_child(nodepath, obj, cur, index);
+	    recurse_level = process_get_command(cur, nodepath, cmd->next,
+		recurse + 1);
+	    strbuf_truncate(nodepath, pathlen);
+	}
+    }
+    if (count == 0 && cmd->next != NULL) {
+	recurse_level = get_chain_depth(cmd, recurse);
+    }
+
+    return(recurse_level);
+}
+
 /*
  * Get a regular key
  */
 int
-get_cmd_none(const ucl_object_t *obj, char *nodepath,
-    const char *command_str, char *remaining_commands, int recurse)
+get_cmd_none(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse)
 {
     const ucl_object_t *cur;
-    char *reqnodelist = strdup(command_str);
-    char *reqnode = NULL;
+    const keypath_t *reqnode = NULL;
+    size_t pathlen;
     int recurse_level = recurse;
-    int arrindex = 0;
+    int arrindex = 0, i;
 
-    /* Separate and loop here */
-    while ((reqnode = strsep(&reqnodelist, " ")) != NULL) {
+    /* Loop over the selectors */
+    for (i = 0; i < cmd->npaths && !halted; i++) {
+	reqnode = &cmd->paths[i];
 	/* User has provided an identifier after the commands */
 	/* Search for selected node */
 	if (debug > 0) {
-	    fprintf(stderr, "DEBUG: Searching for subnode %s\n", reqnode);
+	    fprintf(stderr, "DEBUG: Searching for subnode %s\n", reqnode->str);
 	}
-	cur = ucl_lookup_path_char(obj, reqnode, input_sepchar);
+	cur = keypath_lookup(obj, reqnode);
 	/* If this is the last thing on the stack, output */
-	if (remaining_commands == NULL) {
+	if (cmd->next == NULL) {
 	    /* Would also check cur==null here, but that breaks |keys */
-	    output_key(cur, nodepath, reqnode);
+	    output_key(cur, nodepath->buf, reqnode->str);
 	} else {
 	    /* Return the values of the current object */
-	    char *rcmds = strdup(remaining_commands);
-	    char *next_command = strsep(&rcmds, "|");
-	    if (next_command != NULL) {
-		char *newnodepath = NULL;
-		if (ucl_object_type(obj) == UCL_ARRAY) {
-		    asprintf(&newnodepath, "%s%c%i", nodepath, output_sepchar,
-			arrindex);
-		    arrindex++;
-		} else {
-		    asprintf(&newnodepath, "%s%c%s", nodepath, output_sepchar,
-			ucl_object_key(cur));
-		}
-		if (debug > 2) {
-		    fprintf(stderr, "DEBUG: Calling recurse with %s.%s on %s\n",
-			newnodepath, next_command,
-			ucl_object_emit(cur, UCL_EMIT_CONFIG));
-		}
-		recurse_level = process_get_command(cur, newnodepath,
-		    next_command, rcmds, recurse + 1);
-		free(newnodepath);
+	    pathlen = push_child(nodepath, obj, cur, arrindex);
+	    if (ucl_object_type(obj) == UCL_ARRAY) {
+		arrindex++;
 	    }
+	    if (debug > 2) {
+		fprintf(stderr, "DEBUG: Calling recurse with %s.%s\n",
+		    nodepath->buf, cmd->next->str);
+	    }
+	    recurse_level = process_get_command(cur, nodepath, cmd->next,
+		recurse + 1);
+	    strbuf_truncate(nodepath, pathlen);
+	}
+    }
+
+    return(recurse_level);
+}
+
+/*
+ * Pass on, or output, the first value that reaches this command and stop
+ */
+int
+get_cmd_first(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse)
+{
+    int recurse_level = recurse;
+
+    halted = true;
+    if (cmd->next == NULL) {
+	output_chunk(obj, nodepath->buf, "");
+    } else {
+	recurse_level = process_get_command(obj, nodepath, cmd->next,
+	    recurse + 1);
+    }
+
+    return(recurse_level);
+}
+
+/*
+ * Pass on, or output, the first arg values and stop once they are done
+ */
+int
+get_cmd_limit(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse)
+{
+    get_cmd_t *state = __DECONST(get_cmd_t *, cmd);
+    int recurse_level = recurse;
+
+    if (state->seen >= cmd->arg) {
+	halted = true;
+	return(recurse_level);
+    }
+    state->seen++;
+    if (cmd->next == NULL) {
+	output_chunk(obj, nodepath->buf, "");
+    } else {
+	recurse_level = process_get_command(obj, nodepath, cmd->next,
+	    recurse + 1);
+    }
+    if (state->seen >= cmd->arg) {
+	halted = true;
+    }
+
+    return(recurse_level);
+}
+
+/*
+ * Stop at the first value that exists, the answer is the exit status
+ */
+int
+get_cmd_exists(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse)
+{
+    get_cmd_t *state = __DECONST(get_cmd_t *, cmd);
+
+    if (obj != NULL) {
+	state->seen++;
+	halted = true;
+    }
+
+    return(recurse);
+}
+
+/*
+ * Stop at the first value that is not null or false, get_run() outputs
+ * whether there was one
+ */
+int
+get_cmd_any(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse)
+{
+    get_cmd_t *state = __DECONST(get_cmd_t *, cmd);
+
+    if (obj == NULL || ucl_object_type(obj) == UCL_NULL) {
+	return(recurse);
+    }
+    if (ucl_object_type(obj) == UCL_BOOLEAN && !ucl_object_toboolean(obj)) {
+	return(recurse);
+    }
+    state->seen++;
+    halted = true;
+
+    return(recurse);
+}
+
+/*
+ * Compare val against the literal of pred, setting *cmp like strcmp().
+ * Returns false if the two cannot be compared, e.g. a string and a number.
+ */
+static bool
+get_pred_compare(const get_pred_t *pred, const ucl_object_t *val, int *cmp)
+{
+    const char *str = NULL;
+    size_t len, plen;
+    int64_t ival;
+    double dval;
+
+    switch (ucl_object_type(val)) {
+    case UCL_NULL:
+	*cmp = 0;
+	return (pred->type == UCL_NULL);
+    case UCL_BOOLEAN:
+	*cmp = (int)ucl_object_toboolean(val) - (int)pred->bval;
+	return (pred->type == UCL_BOOLEAN);
+    case UCL_INT:
+	if (pred->type == UCL_INT) {
+	    ival = ucl_object_toint(val);
+	    *cmp = (ival > pred->ival) - (ival < pred->ival);
+	    return true;
+	}
+	/* FALLTHROUGH */
+    case UCL_FLOAT:
+    case UCL_TIME:
+	if (pred->type != UCL_INT && pred->type != UCL_FLOAT) {
+	    return false;
+	}
+	dval = ucl_object_todouble(val);
+	*cmp = (dval > pred->dval) - (dval < pred->dval);
+	return true;
+    case UCL_STRING:
+	/*
+	 * A string is compared with the literal as written, but is only
+	 * ordered against another string
+	 */
+	if (pred->type == UCL_NULL || (pred->type != UCL_STRING &&
+	    pred->op != PRED_EQ && pred->op != PRED_NE)) {
+	    return false;
+	}
+	str = ucl_object_tolstring(val, &len);
+	plen = strlen(pred->str);
+	*cmp = memcmp(str, pred->str, len < plen ? len : plen);
+	if (*cmp == 0) {
+	    *cmp = (len > plen) - (len < plen);
+	}
+	return true;
+    default:
+	return false;
+    }
+}
+
+/*
+ * Does obj satisfy the predicate of a select()
+ */
+static bool
+get_pred_eval(const get_pred_t *pred, const ucl_object_t *obj)
+{
+    const ucl_object_t *val = obj;
+    const char *str = NULL;
+    int cmp = 0;
+
+    if (pred->path.nsegs > 0) {
+	val = keypath_lookup(obj, &pred->path);
+    }
+    if (pred->op == PRED_EXISTS) {
+	return (val != NULL);
+    }
+    if (val == NULL) {
+	/* A missing value is only equal to null */
+	return (pred->type == UCL_NULL) == (pred->op == PRED_EQ) &&
+	    (pred->op == PRED_EQ || pred->op == PRED_NE);
+    }
+    if (pred->op == PRED_MATCH) {
+	if (ucl_object_type(val) == UCL_OBJECT ||
+	    ucl_object_type(val) == UCL_ARRAY) {
+	    return false;
 	}
+	str = ucl_object_type(val) == UCL_STRING ? ucl_object_tostring(val) :
+	    ucl_object_tostring_forced(val);
+	return (str != NULL && regexec(&pred->re, str, 0, NULL, 0) == 0);
+    }
+    if (!get_pred_compare(pred, val, &cmp)) {
+	return (pred->op == PRED_NE);
+    }
+    switch (pred->op) {
+    case PRED_EQ:
+	return (cmp == 0);
+    case PRED_NE:
+	return (cmp != 0);
+    case PRED_LT:
+	return (cmp < 0);
+    case PRED_LE:
+	return (cmp <= 0);
+    case PRED_GT:
+	return (cmp > 0);
+    case PRED_GE:
+	return (cmp >= 0);
+    default:
+	return false;
+    }
+}
+
+/*
+ * Only pass on, or output, the values that satisfy the predicate. Rejected
+ * values are dropped here, before anything is formatted for them.
+ */
+int
+get_cmd_select(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse)
+{
+    int recurse_level = recurse;
+
+    if (!get_pred_eval(cmd->pred, obj)) {
+	return get_chain_depth(cmd, recurse);
+    }
+    if (cmd->next == NULL) {
+	output_chunk(obj, nodepath->buf, "");
+    } else {
+	recurse_level = process_get_command(obj, nodepath, cmd->next,
+	    recurse + 1);
     }
 
     return(recurse_level);
 }
 
+/*
+ * Print str as a table cell: quoted as RFC 4180 asks for --csv, or for TSV
+ * with the backslash escapes database loaders expect
+ */
+static void
+table_str(const char *str, size_t len)
+{
+    const char *p, *end = str + len, *esc;
+
+    if (csv) {
+	for (p = str; p < end; p++) {
+	    if (*p == ',' || *p == '"' || *p == '\r' || *p == '\n') {
+		break;
+	    }
+	}
+	if (p == end) {
+	    output_write(str, len);
+	    return;
+	}
+	output_putc('"');
+	while ((p = memchr(str, '"', end - str)) != NULL) {
+	    output_write(str, p - str + 1);
+	    output_putc('"');
+	    str = p + 1;
+	}
+	output_write(str, end - str);
+	output_putc('"');
+	return;
+    }
+    for (p = str; p < end; p++) {
+	switch (*p) {
+	case '\t':
+	    esc = "\\t";
+	    break;
+	case '\n':
+	    esc = "\\n";
+	    break;
+	case '\r':
+	    esc = "\\r";
+	    break;
+	case '\\':
+	    esc = "\\\\";
+	    break;
+	default:
+	    continue;
+	}
+	output_write(str, p - str);
+	output_write(esc, 2);
+	str = p + 1;
+    }
+    output_write(str, end - str);
+}
+
+/*
+ * Print obj as a table cell, which is left empty for a missing or null
+ * value
+ */
+static void
+table_cell(const ucl_object_t *obj)
+{
+    const char *str = NULL;
+    size_t len;
+
+    switch (ucl_object_type(obj)) {
+    case UCL_OBJECT:
+	output_write("{object}", 8);
+	break;
+    case UCL_ARRAY:
+	output_write("[array]", 7);
+	break;
+    case UCL_INT:
+	output_int(ucl_object_toint(obj));
+	break;
+    case UCL_FLOAT:
+    case UCL_TIME:
+	output_double(ucl_object_todouble(obj), false);
+	break;
+    case UCL_STRING:
+	str = ucl_object_tolstring(obj, &len);
+	table_str(str != NULL ? str : "(null)", str != NULL ? len : 6);
+	break;
+    case UCL_BOOLEAN:
+	output_puts(ucl_object_toboolean(obj) ? "true" : "false");
+	break;
+    case UCL_USERDATA:
+	output_write("{userdata}", 10);
+	break;
+    default:
+	break;
+    }
+}
+
+static void
+table_row(const ucl_object_t *row, const get_cmd_t *cmd)
+{
+    const ucl_object_t *cell;
+    int i;
+
+    output_record_start(true);
+    for (i = 0; i < cmd->npaths; i++) {
+	if (i > 0) {
+	    output_putc(csv ? ',' : '\t');
+	}
+	cell = keypath_lookup(row, &cmd->paths[i]);
+	if (cell != NULL) {
+	    table_cell(cell);
+	}
+    }
+    output_record_end();
+}
+
+/*
+ * Output a row of the values at the column paths for every element of an
+ * array, or for anything else a single row. Rows are TSV, or CSV with
+ * --csv. With --keys the first row of the run names the columns.
+ */
 int
-get_cmd_tab(const ucl_object_t *obj, char *nodepath,
-    const char *command_str, char *remaining_commands, int recurse)
+get_cmd_tab(const ucl_object_t *obj, strbuf_t *nodepath,
+    const get_cmd_t *cmd, int recurse)
 {
+    get_cmd_t *state = __DECONST(get_cmd_t *, cmd);
+    ucl_object_iter_t it = NULL;
+    const ucl_object_t *cur;
+    const char *name;
+    int i;
+
+    if (show_keys == 1 && state->seen++ == 0) {
+	output_record_start(true);
+	for (i = 0; i < cmd->npaths; i++) {
+	    if (i > 0) {
+		output_putc(csv ? ',' : '\t');
+	    }
+	    name = cmd->paths[i].str;
+	    if (name[0] == input_sepchar) {
+		name++;
+	    }
+	    table_str(name, strlen(name));
+	}
+	output_record_end();
+    }
+    if (obj == NULL) {
+	return(recurse);
+    }
+    if (ucl_object_type(obj) == UCL_ARRAY) {
+	while ((cur = ucl_iterate_object(obj, &it, true))) {
+	    table_row(cur, cmd);
+	}
+    } else {
+	table_row(obj, cmd);
+    }
+
     return(recurse);
 }
@@ -0,0 +1,188 @@
+/*-
+ * Copyright (c) 2014-2015 Allan Jude <allanjude@freebsd.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#include <pthread.h>
+
+#include "uclcmd.h"
+
+/*
+ * Worker pool for splitting a traversal into independent tasks.
+ *
+ * Each task runs on a worker thread with outfp pointed at a memory stream
+ * of its own, so workers format in parallel without sharing any output
+ * state. The calling thread passes the captured output on to its own
+ * output buffer strictly in task order, which keeps the result
+ * byte-identical to running the tasks one after another. Workers may only
+ * run JOBS_WINDOW tasks per thread ahead of the task being written, which
+ * bounds the memory held in buffers that are waiting their turn.
+ */
+
+#define JOBS_WINDOW	4
+
+/* Set on worker threads, which run their tasks' nested splits serially */
+__thread bool jobs_worker_thread;
+
+struct job_result {
+	char *buf;
+	size_t len;
+	bool done;
+};
+
+struct job_pool {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	job_func_t func;
+	void *ctx;
+	struct job_result *results;
+	size_t ntasks;
+	size_t next;
+	size_t written;
+	size_t window;
+};
+
+static void *
+jobs_worker(void *arg)
+{
+    struct job_pool *pool = arg;
+    struct job_result *res = NULL;
+    FILE *fp = NULL;
+    size_t i;
+
+    jobs_worker_thread = true;
+    for (;;) {
+	pthread_mutex_lock(&pool->lock);
+	while (pool->next < pool->ntasks &&
+	    pool->next >= pool->written + pool->window) {
+	    pthread_cond_wait(&pool->cond, &pool->lock);
+	}
+	if (pool->next >= pool->ntasks) {
+	    pthread_mutex_unlock(&pool->lock);
+	    break;
+	}
+	i = pool->next++;
+	pthread_mutex_unlock(&pool->lock);
+
+	res = &pool->results[i];
+	fp = open_memstream(&res->buf, &res->len);
+	if (fp == NULL) {
+	    fprintf(stderr, "Error: Unable to buffer output: %s\n",
+		strerror(errno));
+	    exit(1);
+	}
+	outfp = fp;
+	pool->func(pool->ctx, i);
+	output_flush();
+	outfp = NULL;
+	fclose(fp);
+
+	pthread_mutex_lock(&pool->lock);
+	res->done = true;
+	pthread_cond_broadcast(&pool->cond);
+	pthread_mutex_unlock(&pool->lock);
+    }
+
+    arena_free(&scratch);
+    return NULL;
+}
+
+/*
+ * Run func for every index below ntasks on up to jobs threads, writing
+ * their output in index order. Returns false, having run nothing, if not
+ * a single worker could be started, or if called from a worker, where a
+ * second pool would only oversubscribe the CPUs.
+ */
+bool
+jobs_run(size_t ntasks, job_func_t func, void *ctx)
+{
+    struct job_pool pool;
+    pthread_t *threads = NULL;
+    size_t nthreads, i;
+
+    if (jobs_worker_thread) {
+	return false;
+    }
+    nthreads = (size_t)jobs < ntasks ? (size_t)jobs : ntasks;
+    memset(&pool, 0, sizeof(pool));
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.cond, NULL);
+    pool.func = func;
+    pool.ctx = ctx;
+    pool.ntasks = ntasks;
+    pool.window = nthreads * JOBS_WINDOW;
+    pool.results = calloc(ntasks, sizeof(*pool.results));
+    threads = calloc(nthreads, sizeof(*threads));
+    if (pool.results == NULL || threads == NULL) {
+	nthreads = 0;
+    }
+
+    for (i = 0; i < nthreads; i++) {
+	if (pthread_create(&threads[i], NULL, jobs_worker, &pool) != 0) {
+	    break;
+	}
+    }
+    if (i == 0) {
+	if (debug > 0) {
+	    fprintf(stderr, "DEBUG: Unable to start any workers\n");
+	}
+	free(threads);
+	free(pool.results);
+	pthread_cond_destroy(&pool.cond);
+	pthread_mutex_destroy(&pool.lock);
+	return false;
+    }
+    nthreads = i;
+    if (debug > 0) {
+	fprintf(stderr, "DEBUG: Running %zu tasks on %zu threads\n", ntasks,
+	    nthreads);
+    }
+
+    for (i = 0; i < ntasks; i++) {
+	pthread_mutex_lock(&pool.lock);
+	while (!pool.results[i].done) {
+	    pthread_cond_wait(&pool.cond, &pool.lock);
+	}
+	pthread_mutex_unlock(&pool.lock);
+
+	output_write(pool.results[i].buf, pool.results[i].len);
+	free(pool.results[i].buf);
+
+	pthread_mutex_lock(&pool.lock);
+	pool.written = i + 1;
+	pthread_cond_broadcast(&pool.cond);
+	pthread_mutex_unlock(&pool.lock);
+    }
+
+    for (i = 0; i < nthreads; i++) {
+	pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    free(pool.results);
+    pthread_cond_destroy(&pool.cond);
+    pthread_mutex_destroy(&pool.lock);
+    return true;
+}
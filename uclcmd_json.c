@@ -0,0 +1,414 @@
+/*-
+ * Copyright (c) 2014-2015 Allan Jude <allanjude@freebsd.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "uclcmd.h"
+
+/*
+ * Native JSON emitter for get's -j and -c output.
+ *
+ * This writes straight into the output buffer, in the layout
+ * ucl_object_emit() uses for UCL_EMIT_JSON and UCL_EMIT_JSON_COMPACT. Control
+ * characters without a short escape are written as \u00XX, where libucl
+ * writes \uFFFD and loses them, and bytes from 0x7f up are copied as they
+ * are. It walks the document with an explicit
+ * frame stack, and it copies the runs of a string that need no escaping in
+ * one go instead of one character at a time. On x86 those runs are found
+ * 16 bytes at a time with SSE2.
+ */
+
+static const char json_hex[] = "0123456789ABCDEF";
+
+/*
+ * Return the length of the leading run of str that can be written inside a
+ * JSON string as is, that is up to the first control character, quote or
+ * backslash
+ */
+static size_t
+json_clean_run(const unsigned char *str, size_t len)
+{
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i bslash = _mm_set1_epi8('\\');
+    const __m128i ctrl = _mm_set1_epi8(0x1f);
+    __m128i chunk, hits;
+    int mask;
+
+    for (; i + 16 <= len; i += 16) {
+	chunk = _mm_loadu_si128((const __m128i *)(str + i));
+	hits = _mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+	    _mm_cmpeq_epi8(chunk, bslash));
+	/* Bytes up to 0x1f are the ones max(byte, 0x1f) leaves unchanged */
+	hits = _mm_or_si128(hits,
+	    _mm_cmpeq_epi8(_mm_max_epu8(chunk, ctrl), ctrl));
+	mask = _mm_movemask_epi8(hits);
+	if (mask != 0) {
+	    return i + __builtin_ctz(mask);
+	}
+    }
+#endif
+    while (i < len && str[i] >= 0x20 && str[i] != '"' && str[i] != '\\') {
+	i++;
+    }
+    return i;
+}
+
+/*
+ * Write str escaped for the inside of a JSON string
+ */
+static void
+json_chars(const char *str, size_t len)
+{
+    const unsigned char *p = (const unsigned char *)str;
+    char esc[6] = { '\\', 'u', '0', '0' };
+    size_t run;
+
+    while (len > 0) {
+	run = json_clean_run(p, len);
+	output_write((const char *)p, run);
+	if (run == len) {
+	    break;
+	}
+	p += run;
+	len -= run;
+	switch (*p) {
+	case '\n':
+	    output_write("\\n", 2);
+	    break;
+	case '\r':
+	    output_write("\\r", 2);
+	    break;
+	case '\b':
+	    output_write("\\b", 2);
+	    break;
+	case '\t':
+	    output_write("\\t", 2);
+	    break;
+	case '\f':
+	    output_write("\\f", 2);
+	    break;
+	case '\\':
+	    output_write("\\\\", 2);
+	    break;
+	case '"':
+	    output_write("\\\"", 2);
+	    break;
+	default:
+	    esc[4] = json_hex[*p >> 4];
+	    esc[5] = json_hex[*p & 0xf];
+	    output_write(esc, sizeof(esc));
+	    break;
+	}
+	p++;
+	len--;
+    }
+}
+
+static void
+json_string(const char *str, size_t len)
+{
+    output_putc('"');
+    json_chars(str, len);
+    output_putc('"');
+}
+
+static void
+json_tabs(size_t indent, bool compact)
+{
+    static const char spaces[] = "                                "
+	"                                ";
+    size_t len;
+
+    if (compact) {
+	return;
+    }
+    for (len = indent * 4; len > sizeof(spaces) - 1;
+	len -= sizeof(spaces) - 1) {
+	output_write(spaces, sizeof(spaces) - 1);
+    }
+    output_write(spaces, len);
+}
+
+static void
+json_key(const ucl_object_t *obj, bool compact)
+{
+    const char *key;
+    size_t keylen;
+
+    key = ucl_object_keyl(obj, &keylen);
+    json_string(key, keylen);
+    if (compact) {
+	output_putc(':');
+    } else {
+	output_write(": ", 2);
+    }
+}
+
+/* Containers with at least this many elements are emitted in parallel */
+#define JSON_PARALLEL_MIN	4096
+
+/* Elements of a large container, split into ranges for jobs_run() */
+struct json_split {
+	const ucl_object_t **elts;
+	size_t nelts;
+	size_t chunk;
+	size_t indent;
+	bool is_obj;
+	bool compact;
+};
+
+static void json_walk(const ucl_object_t *obj, size_t indent, bool chain,
+    bool compact);
+
+/*
+ * Emit one range of elements. Every element after the first of the whole
+ * container starts with a separator, so the ranges simply concatenate.
+ */
+static void
+json_job(void *ctx, size_t index)
+{
+    struct json_split *split = ctx;
+    const ucl_object_t *cur;
+    size_t i, end;
+
+    end = (index + 1) * split->chunk;
+    if (end > split->nelts) {
+	end = split->nelts;
+    }
+    for (i = index * split->chunk; i < end; i++) {
+	cur = split->elts[i];
+	if (i > 0) {
+	    output_write(",\n", split->compact ? 1 : 2);
+	}
+	json_tabs(split->indent + 1, split->compact);
+	if (split->is_obj) {
+	    json_key(cur, split->compact);
+	}
+	json_walk(cur, split->indent + 1, split->is_obj && cur->next != NULL,
+	    split->compact);
+    }
+}
+
+/*
+ * With --jobs, emit a large object or array at the given indent as ranges
+ * of its elements formatted on separate threads. jobs_run() writes the
+ * ranges back in order, so the result is the same as emitting it serially.
+ * Returns false if obj should be emitted serially instead.
+ */
+static bool
+json_parallel(const ucl_object_t *obj, size_t indent, bool compact)
+{
+    struct json_split split;
+    ucl_object_iter_t it = NULL;
+    const ucl_object_t *cur, **tmp;
+    size_t size, ntasks, i;
+
+    if (jobs < 2 || obj->len < JSON_PARALLEL_MIN) {
+	return false;
+    }
+    memset(&split, 0, sizeof(split));
+    size = obj->len;
+    split.elts = malloc(size * sizeof(*split.elts));
+    if (split.elts == NULL) {
+	/* Nothing has been written yet, so the serial path can take over */
+	return false;
+    }
+    while ((cur = ucl_iterate_object(obj, &it, true))) {
+	if (split.nelts == size) {
+	    size *= 2;
+	    tmp = realloc(split.elts, size * sizeof(*split.elts));
+	    if (tmp == NULL) {
+		free(split.elts);
+		return false;
+	    }
+	    split.elts = tmp;
+	}
+	split.elts[split.nelts++] = cur;
+    }
+    split.indent = indent;
+    split.is_obj = ucl_object_type(obj) == UCL_OBJECT;
+    split.compact = compact;
+    /* Several ranges per thread, so one slow range does not stall the rest */
+    split.chunk = (split.nelts + jobs * 8 - 1) / (jobs * 8);
+    if (split.chunk < JSON_PARALLEL_MIN / 4) {
+	split.chunk = JSON_PARALLEL_MIN / 4;
+    }
+    ntasks = (split.nelts + split.chunk - 1) / split.chunk;
+
+    output_write(split.is_obj ? "{\n" : "[\n", compact ? 1 : 2);
+    if (!jobs_run(ntasks, json_job, &split)) {
+	/* Already on a worker, or no threads to be had */
+	for (i = 0; i < ntasks; i++) {
+	    json_job(&split, i);
+	}
+    }
+    if (!compact) {
+	output_putc('\n');
+	json_tabs(indent, compact);
+    }
+    output_putc(split.is_obj ? '}' : ']');
+    free(split.elts);
+
+    return true;
+}
+
+/*
+ * Write a scalar, or the opening bracket of a container, in which case a
+ * frame is pushed for its elements. chain is set for a key that has been
+ * given more than once, which is written as an array of its values.
+ */
+static void
+json_value(walk_t *walk, const ucl_object_t *obj, size_t indent, bool chain,
+    bool compact)
+{
+    walk_frame_t *frame;
+    const char *str;
+    size_t len;
+
+    if (chain) {
+	output_write("[\n", compact ? 1 : 2);
+	frame = walk_push(walk, obj);
+	frame->sub = obj;
+	frame->chain = obj;
+	return;
+    }
+    switch (ucl_object_type(obj)) {
+    case UCL_OBJECT:
+	if (!json_parallel(obj, indent, compact)) {
+	    output_write("{\n", compact ? 1 : 2);
+	    walk_push(walk, obj);
+	}
+	break;
+    case UCL_ARRAY:
+	if (!json_parallel(obj, indent, compact)) {
+	    output_write("[\n", compact ? 1 : 2);
+	    walk_push(walk, obj);
+	}
+	break;
+    case UCL_INT:
+	output_int(ucl_object_toint(obj));
+	break;
+    case UCL_FLOAT:
+    case UCL_TIME:
+	output_double(ucl_object_todouble(obj), true);
+	break;
+    case UCL_BOOLEAN:
+	output_puts(ucl_object_toboolean(obj) ? "true" : "false");
+	break;
+    case UCL_STRING:
+	str = ucl_object_tolstring(obj, &len);
+	json_string(str, len);
+	break;
+    case UCL_NULL:
+	output_write("null", 4);
+	break;
+    default:
+	json_string("null", 4);
+	break;
+    }
+}
+
+/*
+ * Emit obj, whose first line has already been indented to indent
+ */
+static void
+json_walk(const ucl_object_t *obj, size_t indent, bool chain, bool compact)
+{
+    walk_frame_t *frame;
+    const ucl_object_t *cur;
+    walk_t walk;
+    bool is_obj;
+
+    memset(&walk, 0, sizeof(walk));
+    json_value(&walk, obj, indent, chain, compact);
+    while (walk.depth > 0) {
+	frame = &walk.frames[walk.depth - 1];
+	is_obj = frame->sub == NULL &&
+	    ucl_object_type(frame->obj) == UCL_OBJECT;
+	if (frame->sub != NULL) {
+	    cur = frame->chain;
+	    if (cur != NULL) {
+		frame->chain = cur->next;
+	    }
+	} else {
+	    cur = ucl_iterate_object(frame->obj, &frame->it, true);
+	}
+
+	if (cur == NULL) {
+	    walk_pop(&walk);
+	    if (!compact) {
+		output_putc('\n');
+		json_tabs(indent + walk.depth, compact);
+	    }
+	    output_putc(is_obj ? '}' : ']');
+	    continue;
+	}
+
+	if (frame->count++ > 0) {
+	    output_write(",\n", compact ? 1 : 2);
+	}
+	json_tabs(indent + walk.depth, compact);
+	if (is_obj) {
+	    json_key(cur, compact);
+	}
+	json_value(&walk, cur, indent + walk.depth, is_obj && cur->next != NULL,
+	    compact);
+    }
+    walk_free(&walk);
+}
+
+void
+json_emit(const ucl_object_t *obj, bool compact)
+{
+    json_walk(obj, 0, false, compact);
+}
+
+/*
+ * Emit the --ndjson record for one result, {"path":...,"value":...}, with
+ * the path as the query language writes it and the value as compact JSON
+ */
+void
+json_record(const ucl_object_t *obj, const char *nodepath, const char *key)
+{
+    output_write("{\"path\":\"", 9);
+    json_chars(nodepath, strlen(nodepath));
+    if (key != NULL) {
+	json_chars(key, strlen(key));
+    }
+    output_write("\",\"value\":", 10);
+    if (obj == NULL) {
+	output_write("null", 4);
+    } else {
+	json_walk(obj, 0, false, true);
+    }
+    output_putc('}');
+}
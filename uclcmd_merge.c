@@ -36,11 +36,11 @@ merge_main(int argc, char *argv[])
     bool success = false;
 
     /* Initialize parser */
-    parser = ucl_parser_new(UCL_PARSER_KEY_LOWERCASE |
-        UCL_PARSER_NO_IMPLICIT_ARRAYS);
+    parser = ucl_parser_new(UCLCMD_PARSER_FLAGS);
 
     /*	options	descriptor */
     static struct option longopts[] = {
+	{ "cache",	optional_argument,	NULL,		'C' },
 	{ "cjson",	no_argument,		&output_type,
 	    UCL_EMIT_JSON_COMPACT },
 	{ "debug",	optional_argument,	NULL,		'd' },
@@ -79,14 +79,11 @@ merge_main(int argc, char *argv[])
 	case 'e':
 	    expand = 1;
 	    break;
+	case 'C':
+	    cache_init(optarg);
+	    break;
 	case 'f':
 	    filename = optarg;
-	    if (strcmp(optarg, "-") == 0) {
-		/* Input from STDIN */
-		root_obj = parse_input(parser, stdin);
-	    } else {
-		root_obj = parse_file(parser, filename);
-	    }
 	    break;
 	case 'i':
 	    include_file = optarg;
@@ -122,13 +119,17 @@ merge_main(int argc, char *argv[])
     }
     argc -= optind;
     argv += optind;
+    output_init();
 
     if (argc == 0) {
 	usage();
     }
 
-    if (filename == NULL) {
+    if (filename == NULL || strcmp(filename, "-") == 0) {
+	/* Input from STDIN */
 	root_obj = parse_input(parser, stdin);
+    } else {
+	root_obj = parse_file(parser, filename);
     }
 
     if (argc > 1) { /* XXX: need test for if > 2 inputs */
@@ -159,18 +160,18 @@ merge_mode(char *destination_node, char *data)
     ucl_object_t *sub_obj = NULL;
     ucl_object_t *old_obj = NULL;
     ucl_object_t *tmp_obj = NULL;
+    node_ref_t ref;
     int success = 0;
 
-    setparser = ucl_parser_new(UCL_PARSER_KEY_LOWERCASE |
-	UCL_PARSER_NO_IMPLICIT_ARRAYS);
+    setparser = ucl_parser_new(UCLCMD_PARSER_FLAGS);
 
     /* Lookup the destination to write to */
-    dst_obj = get_parent(destination_node);
-    sub_obj = get_object(destination_node);
-
-    if (sub_obj == NULL) {
+    if (!resolve_path(destination_node, &ref)) {
+	node_ref_free(&ref);
 	return false;
     }
+    dst_obj = ref.parent;
+    sub_obj = ref.child;
 
     if (include_file != NULL) {
 	/* get UCL to add from file */
@@ -184,15 +185,12 @@ merge_mode(char *destination_node, char *data)
     }
 
     if (debug > 0) {
-	char *rt = NULL, *dt = NULL, *st = NULL;
+	const char *rt = NULL, *dt = NULL, *st = NULL;
 	rt = type_as_string(dst_obj);
 	dt = type_as_string(sub_obj);
 	st = type_as_string(set_obj);
 	fprintf(stderr, "root type: %s, destination type: %s, new type: %s\n",
 	    rt, dt, st);
-	if (rt != NULL) free(rt);
-	if (dt != NULL) free(dt);
-	if (st != NULL) free(st);
 
 	fprintf(stderr, "Merging key %s to root: %s\n",
 	    ucl_object_key(sub_obj), ucl_object_key(dst_obj));
@@ -261,6 +259,10 @@ merge_mode(char *destination_node, char *data)
 	    ucl_object_key(sub_obj), 0, true);
     }
 
+    if (success) {
+	path_index_invalidate(&ref);
+    }
+    node_ref_free(&ref);
     return success;
 }
 
@@ -26,6 +26,12 @@
  * $FreeBSD$
  */
 
+#include <ctype.h>
+#include <float.h>
+#include <math.h>
+#include <stdarg.h>
+#include <time.h>
+
 #include "uclcmd.h"
 
 int
@@ -35,11 +41,11 @@ output_main(int argc, char *argv[])
     int ret = 0, ch;
 
     /* Initialize parser */
-    parser = ucl_parser_new(UCL_PARSER_KEY_LOWERCASE |
-        UCL_PARSER_NO_IMPLICIT_ARRAYS);
+    parser = ucl_parser_new(UCLCMD_PARSER_FLAGS);
 
     /*	options	descriptor */
     static struct option longopts[] = {
+	{ "cache",      optional_argument,      NULL,       	'C' },
 	{ "file",       required_argument,      NULL,       	'f' },
 	{ "input",    	no_argument,            NULL,  		'i' },
 	{ NULL,         0,                      NULL,       	0 }
@@ -47,14 +53,11 @@ output_main(int argc, char *argv[])
 
     while ((ch = getopt_long(argc, argv, "f:i:", longopts, NULL)) != -1) {
 	switch (ch) {
+	case 'C':
+	    cache_init(optarg);
+	    break;
 	case 'f':
 	    filename = optarg;
-	    if (strcmp(optarg, "-") == 0) {
-		/* Input from STDIN */
-		root_obj = parse_input(parser, stdin);
-	    } else {
-		root_obj = parse_file(parser, filename);
-	    }
 	    break;
 	case 'i':
 	    printf("Not implemented yet\n");
@@ -69,8 +72,11 @@ output_main(int argc, char *argv[])
     argc -= optind;
     argv += optind;
 
-    if (filename == NULL) {
+    if (filename == NULL || strcmp(filename, "-") == 0) {
+	/* Input from STDIN */
 	root_obj = parse_input(parser, stdin);
+    } else {
+	root_obj = parse_file(parser, filename);
     }
 
     ucl_obj_dump(root_obj, 0);
@@ -84,279 +90,1093 @@ output_main(int argc, char *argv[])
     return(ret);
 }
 
+/*
+ * Buffered output sink.
+ *
+ * Everything get and find print goes through a per-thread buffer that is
+ * only handed to stdio, as a single fwrite() to outfp, when it fills up or
+ * is flushed. A value line is then a handful of memcpy()s rather than as
+ * many locked stdio calls. Anything that writes to outfp directly must
+ * call output_flush() first, and cleanup() flushes at the end of a run.
+ */
+static __thread char outbuf[OUTPUT_BUFSIZE];
+static __thread size_t outlen;
+
+/*
+ * A --netstring record can only be written out once its length is known.
+ * Until then it stays in outbuf from recstart on, and whatever of it a
+ * flush has to make room for is moved to spill.
+ */
+static __thread bool recording;
+static __thread size_t recstart;
+static __thread char *spill;
+static __thread size_t spilllen, spillsize;
+
+static void
+output_spill(const char *str, size_t len)
+{
+    char *tmp;
+    size_t size;
+
+    if (spilllen + len > spillsize) {
+	size = spillsize;
+	while (spilllen + len > size) {
+	    size = size ? size * 2 : OUTPUT_BUFSIZE;
+	}
+	/* Dropping part of the record would leave its length wrong */
+	tmp = realloc(spill, size);
+	if (tmp == NULL) {
+	    fprintf(stderr, "Error: Unable to buffer output: %s\n",
+		strerror(errno));
+	    exit(1);
+	}
+	spill = tmp;
+	spillsize = size;
+    }
+    memcpy(spill + spilllen, str, len);
+    spilllen += len;
+}
+
+void
+output_flush()
+{
+    if (recording) {
+	if (recstart > 0 && outfp != NULL) {
+	    fwrite(outbuf, 1, recstart, outfp);
+	}
+	output_spill(outbuf + recstart, outlen - recstart);
+	recstart = 0;
+	outlen = 0;
+	return;
+    }
+    if (outlen > 0 && outfp != NULL) {
+	fwrite(outbuf, 1, outlen, outfp);
+    }
+    outlen = 0;
+}
+
+void
+output_write(const char *str, size_t len)
+{
+    if (len > OUTPUT_BUFSIZE - outlen) {
+	output_flush();
+	if (len >= OUTPUT_BUFSIZE) {
+	    if (recording) {
+		output_spill(str, len);
+	    } else {
+		fwrite(str, 1, len, outfp);
+	    }
+	    return;
+	}
+    }
+    memcpy(outbuf + outlen, str, len);
+    outlen += len;
+}
+
+void
+output_putc(char c)
+{
+    if (outlen == OUTPUT_BUFSIZE) {
+	output_flush();
+    }
+    outbuf[outlen++] = c;
+}
+
+void
+output_puts(const char *str)
+{
+    output_write(str, strlen(str));
+}
+
+/*
+ * Print num two digits at a time, which halves the divisions the usual
+ * digit loop needs
+ */
+void
+output_int(intmax_t num)
+{
+    static const char pairs[] =
+	"00010203040506070809101112131415161718192021222324252627282930313233"
+	"34353637383940414243444546474849505152535455565758596061626364656667"
+	"6869707172737475767778798081828384858687888990919293949596979899";
+    char buf[24], *p = buf + sizeof(buf);
+    uintmax_t u = num < 0 ? -(uintmax_t)num : (uintmax_t)num;
+
+    while (u >= 100) {
+	p -= 2;
+	memcpy(p, &pairs[(u % 100) * 2], 2);
+	u /= 100;
+    }
+    if (u >= 10) {
+	p -= 2;
+	memcpy(p, &pairs[u * 2], 2);
+    } else {
+	*--p = '0' + u;
+    }
+    if (num < 0) {
+	*--p = '-';
+    }
+    output_write(p, buf + sizeof(buf) - p);
+}
+
+void
+output_printf(const char *fmt, ...)
+{
+    va_list ap;
+    char *str = NULL;
+    int len;
+
+    va_start(ap, fmt);
+    len = vsnprintf(outbuf + outlen, OUTPUT_BUFSIZE - outlen, fmt, ap);
+    va_end(ap);
+    if (len < 0) {
+	return;
+    }
+    if ((size_t)len < OUTPUT_BUFSIZE - outlen) {
+	outlen += len;
+	return;
+    }
+    /* Did not fit, try again with the whole buffer */
+    output_flush();
+    va_start(ap, fmt);
+    if ((size_t)len < OUTPUT_BUFSIZE) {
+	len = vsnprintf(outbuf, OUTPUT_BUFSIZE, fmt, ap);
+	if (len >= 0) {
+	    outlen = len;
+	}
+    } else if (vasprintf(&str, fmt, ap) >= 0) {
+	/* Through output_write(), which knows to spill a --netstring record */
+	output_write(str, len);
+	free(str);
+    }
+    va_end(ap);
+}
+
+/* Longest --ndjson holds output back before passing it on */
+#define OUTPUT_FLUSH_MS	100
+
+static long
+output_elapsed_ms(const struct timespec *since, const struct timespec *now)
+{
+
+    return ((now->tv_sec - since->tv_sec) * 1000 +
+	(now->tv_nsec - since->tv_nsec) / 1000000);
+}
+
+/*
+ * Called at the end of each record, to pass the buffered output on once it
+ * has been held for OUTPUT_FLUSH_MS, so a long traversal still streams to
+ * stdout or an --out file. The first record after a quiet spell, the very
+ * first included, is passed on at once. Worker threads write to a buffer
+ * of their own and are left alone.
+ */
+static void
+output_tick()
+{
+    static __thread struct timespec flushed, held;
+    struct timespec now;
+
+    if (jobs_worker_thread || outlen == 0) {
+	return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (held.tv_sec == 0 && held.tv_nsec == 0) {
+	/* Output has just started being held */
+	if ((flushed.tv_sec != 0 || flushed.tv_nsec != 0) &&
+	    output_elapsed_ms(&flushed, &now) < OUTPUT_FLUSH_MS) {
+	    held = now;
+	    return;
+	}
+    } else if (output_elapsed_ms(&held, &now) < OUTPUT_FLUSH_MS) {
+	return;
+    }
+    output_flush();
+    fflush(outfp);
+    flushed = now;
+    held.tv_sec = held.tv_nsec = 0;
+}
+
+/*
+ * Start an output record. With --nonewline, text records after the first
+ * are preceded by a space, which documents emitted whole never were, so
+ * they pass spaced as false.
+ */
 void
-output_chunk(const ucl_object_t *obj, char *nodepath, const char *inkey)
+output_record_start(bool spaced)
+{
+    if (records == RECORDS_NETSTRING) {
+	recording = true;
+	recstart = outlen;
+    } else if (spaced && firstline == false) {
+	output_putc(' ');
+    }
+}
+
+/*
+ * End an output record: with a newline, or for --nonewline nothing until
+ * the next record starts, with a NUL for --null, or for --netstring by
+ * writing the length in front of the record and a comma after it
+ */
+void
+output_record_end()
+{
+    char hdr[24];
+    size_t len;
+    int hlen;
+
+    switch (records) {
+    case RECORDS_NUL:
+	output_putc('\0');
+	break;
+    case RECORDS_NETSTRING:
+	len = spilllen + outlen - recstart;
+	hlen = snprintf(hdr, sizeof(hdr), "%zu:", len);
+	if (spilllen == 0 && outlen + hlen < OUTPUT_BUFSIZE) {
+	    memmove(outbuf + recstart + hlen, outbuf + recstart,
+		outlen - recstart);
+	    memcpy(outbuf + recstart, hdr, hlen);
+	    outlen += hlen;
+	    recording = false;
+	} else {
+	    /* Too big for the buffer, the whole record is in spill now */
+	    output_flush();
+	    recording = false;
+	    output_write(hdr, hlen);
+	    output_write(spill, spilllen);
+	    free(spill);
+	    spill = NULL;
+	    spilllen = spillsize = 0;
+	}
+	output_putc(',');
+	break;
+    default:
+	if (nonewline) {
+	    firstline = false;
+	} else {
+	    output_putc('\n');
+	}
+	break;
+    }
+}
+
+/*
+ * Format val into buf the way it has always been printed: with %f in text
+ * mode, or as libucl's emitters format doubles. When that would lose
+ * precision, as %f does for 1e-9 or pi, the shortest %g form that reads
+ * back as exactly val is used instead. Returns the length.
+ */
+size_t
+output_format_double(char *buf, size_t size, double val, bool ucl_style)
+{
+    double frac, ipart;
+    int lo, hi, prec;
+
+    if (!ucl_style) {
+	snprintf(buf, size, "%f", val);
+    } else {
+	frac = modf(val, &ipart);
+	if (frac == 0) {
+	    snprintf(buf, size, "%.1lf", val);
+	} else if (frac < 0.0000001 && frac > -0.0000001) {
+	    snprintf(buf, size, "%.*lg", DBL_DIG, val);
+	} else {
+	    snprintf(buf, size, "%lf", val);
+	}
+    }
+    if (isfinite(val) && strtod(buf, NULL) != val) {
+	/*
+	 * The slow path, for the values the forms above lose precision on.
+	 * More digits never read back further from val and 17 always read
+	 * back exactly, so binary search the digit count: at most 5 rounds
+	 * of snprintf() and strtod() instead of up to 17.
+	 */
+	lo = 1;
+	hi = 17;
+	while (lo < hi) {
+	    prec = lo + (hi - lo) / 2;
+	    snprintf(buf, size, "%.*g", prec, val);
+	    if (strtod(buf, NULL) == val) {
+		hi = prec;
+	    } else {
+		lo = prec + 1;
+	    }
+	}
+	snprintf(buf, size, "%.*g", hi, val);
+    }
+    return strlen(buf);
+}
+
+void
+output_double(double val, bool ucl_style)
+{
+    char buf[512];
+    size_t len;
+
+    len = output_format_double(buf, sizeof(buf), val, ucl_style);
+    output_write(buf, len);
+}
+
+/*
+ * Print a node path or key, translating separators on the way out rather
+ * than rewriting the caller's buffer, which may be a traversal's live path
+ */
+static void
+output_path(const char *path, bool shellvars)
+{
+    size_t len = strlen(path), i;
+    char c, *dst;
+
+    if (!shellvars && input_sepchar == output_sepchar) {
+	output_write(path, len);
+	return;
+    }
+    if (len > OUTPUT_BUFSIZE - outlen) {
+	output_flush();
+    }
+    if (len > OUTPUT_BUFSIZE) {
+	for (i = 0; i < len; i++) {
+	    c = path[i];
+	    if (shellvars && c == '.') {
+		c = '_';
+	    }
+	    output_putc(c == input_sepchar ? output_sepchar : c);
+	}
+	return;
+    }
+    dst = outbuf + outlen;
+    for (i = 0; i < len; i++) {
+	c = path[i];
+	if (shellvars && c == '.') {
+	    c = '_';
+	}
+	dst[i] = (c == input_sepchar) ? output_sepchar : c;
+    }
+    outlen += len;
+}
+
+/*
+ * printf("%s", NULL) used to print (null) for a missing string, keep that
+ */
+static void
+output_str(const char *str)
+{
+    output_puts(str != NULL ? str : "(null)");
+}
+
+/*
+ * Print nodepath and key as a shell variable name for --export: after the
+ * prefix, joined to it by an underscore, and with every character a name
+ * cannot hold replaced by one
+ */
+static void
+output_export_name(const char *nodepath, const char *key)
+{
+    const char *str = nodepath[0] != '\0' ? nodepath : key;
+    size_t plen = strlen(export_prefix);
+    char c;
+
+    output_write(export_prefix, plen);
+    if ((plen > 0 && export_prefix[plen - 1] != '_' && str[0] != '_') ||
+	(plen == 0 && isdigit((unsigned char)str[0]))) {
+	output_putc('_');
+    }
+    for (; *nodepath != '\0'; nodepath++) {
+	c = *nodepath;
+	output_putc(isalnum((unsigned char)c) ? c : '_');
+    }
+    for (; *key != '\0'; key++) {
+	c = *key;
+	output_putc(isalnum((unsigned char)c) ? c : '_');
+    }
+}
+
+/*
+ * Print str inside a single quoted shell word, where the only character
+ * that needs care is the quote itself
+ */
+static void
+output_shquote(const char *str, size_t len)
+{
+    const char *quote, *end = str + len;
+
+    while ((quote = memchr(str, '\'', end - str)) != NULL) {
+	output_write(str, quote - str);
+	output_write("'\\''", 4);
+	str = quote + 1;
+    }
+    output_write(str, end - str);
+}
+
+static void
+output_keyprefix(const char *nodepath, const char *key, bool shellvars)
+{
+    if (export_prefix != NULL) {
+	output_export_name(nodepath, key);
+    } else {
+	output_path(nodepath, shellvars);
+	output_path(key, false);
+    }
+    output_putc('=');
+}
+
+static void output_key_common(const ucl_object_t *obj, const char *nodepath,
+    const char *key, bool shellvars);
+
+static void
+output_text(const ucl_object_t *obj, const char *nodepath, const char *key)
+{
+    output_key_common(obj, nodepath, key, shvars);
+}
+
+/*
+ * Callbacks for ucl_object_emit_full() that write into the output buffer,
+ * so a document is streamed out as it is emitted instead of being built up
+ * in memory first
+ */
+static int
+output_emit_character(unsigned char c, size_t nchars, void *ud)
+{
+    while (nchars-- > 0) {
+	output_putc(c);
+    }
+    return 0;
+}
+
+static int
+output_emit_len(const unsigned char *str, size_t len, void *ud)
+{
+    output_write((const char *)str, len);
+    return 0;
+}
+
+static int
+output_emit_int(int64_t val, void *ud)
+{
+    output_int(val);
+    return 0;
+}
+
+static int
+output_emit_double(double val, void *ud)
+{
+    output_double(val, true);
+    return 0;
+}
+
+static struct ucl_emitter_functions output_emitter = {
+	.ucl_emitter_append_character = output_emit_character,
+	.ucl_emitter_append_len = output_emit_len,
+	.ucl_emitter_append_int = output_emit_int,
+	.ucl_emitter_append_double = output_emit_double,
+};
+
+/* Objects and arrays with at least this many elements are emitted in parallel */
+#define EMIT_PARALLEL_MIN	4096
+
+/*
+ * libucl indents a value as though it were the whole document, so a value
+ * emitted on its own that belongs indent levels deep has those levels
+ * added to the start of every line after the first.
+ */
+struct emit_nested {
+	size_t indent;
+	bool bol;
+};
+
+/* Elements of a large object or array, split into ranges for jobs_run() */
+struct emit_split {
+	const ucl_object_t **elts;
+	size_t nelts;
+	size_t chunk;
+	bool is_obj;
+};
+
+static void
+output_spaces(size_t n)
+{
+    static const char spaces[] = "                                ";
+
+    for (; n > sizeof(spaces) - 1; n -= sizeof(spaces) - 1) {
+	output_write(spaces, sizeof(spaces) - 1);
+    }
+    output_write(spaces, n);
+}
+
+static void
+emit_nested_indent(struct emit_nested *nest)
+{
+    if (nest->bol) {
+	output_spaces(nest->indent * 4);
+	nest->bol = false;
+    }
+}
+
+static int
+emit_nested_character(unsigned char c, size_t nchars, void *ud)
+{
+    struct emit_nested *nest = ud;
+
+    if (nchars == 0) {
+	return 0;
+    }
+    if (c == '\n') {
+	nest->bol = true;
+    } else {
+	emit_nested_indent(nest);
+    }
+    return output_emit_character(c, nchars, NULL);
+}
+
+static int
+emit_nested_len(const unsigned char *str, size_t len, void *ud)
+{
+    struct emit_nested *nest = ud;
+    const unsigned char *nl;
+    size_t n;
+
+    while (len > 0) {
+	nl = memchr(str, '\n', len);
+	n = nl == NULL ? len : (size_t)(nl - str) + 1;
+	if (str[0] != '\n') {
+	    emit_nested_indent(nest);
+	}
+	output_write((const char *)str, n);
+	if (nl != NULL) {
+	    nest->bol = true;
+	}
+	str += n;
+	len -= n;
+    }
+    return 0;
+}
+
+static int
+emit_nested_int(int64_t val, void *ud)
+{
+    emit_nested_indent(ud);
+    return output_emit_int(val, NULL);
+}
+
+static int
+emit_nested_double(double val, void *ud)
+{
+    emit_nested_indent(ud);
+    return output_emit_double(val, NULL);
+}
+
+/*
+ * Whether obj holds a string the UCL emitter writes as a heredoc, whose
+ * lines must not be indented
+ */
+static bool
+emit_has_multiline(const ucl_object_t *obj)
+{
+    walk_t walk;
+    walk_frame_t *frame = NULL;
+    const ucl_object_t *cur;
+    bool found = false;
+
+    memset(&walk, 0, sizeof(walk));
+    frame = walk_push(&walk, obj);
+    frame->chain = obj;
+    while (!found && walk.depth > 0) {
+	frame = &walk.frames[walk.depth - 1];
+	cur = walk_iter_next(&frame->chain, &frame->it);
+	if (cur == NULL) {
+	    walk_pop(&walk);
+	    continue;
+	}
+	if (cur->flags & UCL_OBJECT_MULTILINE) {
+	    found = true;
+	} else if (ucl_object_type(cur) == UCL_OBJECT ||
+	    ucl_object_type(cur) == UCL_ARRAY) {
+	    frame = walk_push(&walk, cur);
+	    frame->chain = cur;
+	}
+    }
+    walk_free(&walk);
+
+    return found;
+}
+
+/*
+ * Write one element of a UCL document at the given indent, laid out the
+ * way libucl lays it out when it emits the whole document
+ */
+static void
+emit_elt(const ucl_object_t *obj, size_t indent, bool print_key)
+{
+    struct emit_nested nest;
+    struct ucl_emitter_functions nested = {
+	.ucl_emitter_append_character = emit_nested_character,
+	.ucl_emitter_append_len = emit_nested_len,
+	.ucl_emitter_append_int = emit_nested_int,
+	.ucl_emitter_append_double = emit_nested_double,
+	.ud = &nest,
+    };
+    ucl_object_t *kobj = NULL;
+    bool container;
+
+    container = ucl_object_type(obj) == UCL_OBJECT ||
+	ucl_object_type(obj) == UCL_ARRAY;
+    output_spaces(indent * 4);
+    if (print_key) {
+	if (obj->flags & UCL_OBJECT_NEED_KEY_ESCAPE) {
+	    /* Quoted by libucl, exactly as it would be in the document */
+	    kobj = ucl_object_fromlstring(obj->key, obj->keylen);
+	    ucl_object_emit_full(kobj, UCL_EMIT_JSON_COMPACT, &output_emitter,
+		NULL);
+	    ucl_object_unref(kobj);
+	} else {
+	    output_write(obj->key, obj->keylen);
+	}
+	output_write(" = ", container ? 1 : 3);
+    }
+    nest.indent = indent;
+    nest.bol = false;
+    if (ucl_object_type(obj) == UCL_OBJECT) {
+	/* The braces of a document's top object are left out */
+	output_write("{\n", 2);
+	nest.indent = indent + 1;
+	nest.bol = true;
+	ucl_object_emit_full(obj, UCL_EMIT_CONFIG, &nested, NULL);
+	output_spaces(indent * 4);
+	output_write("}\n", 2);
+    } else {
+	ucl_object_emit_full(obj, UCL_EMIT_CONFIG, &nested, NULL);
+	if (container) {
+	    output_putc('\n');
+	} else {
+	    output_write(print_key ? ";\n" : ",\n", 2);
+	}
+    }
+}
+
+static void
+emit_job(void *ctx, size_t index)
+{
+    struct emit_split *split = ctx;
+    size_t i, end;
+
+    end = (index + 1) * split->chunk;
+    if (end > split->nelts) {
+	end = split->nelts;
+    }
+    for (i = index * split->chunk; i < end; i++) {
+	emit_elt(split->elts[i], split->is_obj ? 0 : 1, split->is_obj);
+    }
+}
+
+/*
+ * With --jobs, emit a large object or array as UCL by handing ranges of
+ * its elements to ucl_object_emit_full() on separate threads. Only the
+ * elements of the document's top level are split, since libucl cannot be
+ * asked to emit a value partway through a document. Returns false if obj
+ * should be emitted serially instead.
+ */
+static bool
+emit_parallel(const ucl_object_t *obj)
+{
+    struct emit_split split;
+    ucl_object_iter_t it = NULL;
+    const ucl_object_t *cur, *elt, **tmp;
+    size_t size, ntasks, i;
+
+    if (jobs < 2 || output_type != UCL_EMIT_CONFIG ||
+	(ucl_object_type(obj) != UCL_OBJECT &&
+	ucl_object_type(obj) != UCL_ARRAY) ||
+	obj->len < EMIT_PARALLEL_MIN || emit_has_multiline(obj)) {
+	return false;
+    }
+    memset(&split, 0, sizeof(split));
+    split.is_obj = ucl_object_type(obj) == UCL_OBJECT;
+    size = obj->len;
+    split.elts = malloc(size * sizeof(*split.elts));
+    if (split.elts == NULL) {
+	return false;
+    }
+    while ((cur = ucl_iterate_object(obj, &it, true))) {
+	/* A key given more than once is written once per value */
+	for (elt = cur; elt != NULL; elt = split.is_obj ? elt->next : NULL) {
+	    if (split.nelts == size) {
+		size *= 2;
+		tmp = realloc(split.elts, size * sizeof(*split.elts));
+		if (tmp == NULL) {
+		    free(split.elts);
+		    return false;
+		}
+		split.elts = tmp;
+	    }
+	    split.elts[split.nelts++] = elt;
+	}
+    }
+    split.chunk = (split.nelts + jobs * 8 - 1) / (jobs * 8);
+    if (split.chunk < EMIT_PARALLEL_MIN / 4) {
+	split.chunk = EMIT_PARALLEL_MIN / 4;
+    }
+    ntasks = (split.nelts + split.chunk - 1) / split.chunk;
+
+    if (!split.is_obj) {
+	output_write("[\n", 2);
+    }
+    if (!jobs_run(ntasks, emit_job, &split)) {
+	for (i = 0; i < ntasks; i++) {
+	    emit_job(&split, i);
+	}
+    }
+    if (!split.is_obj) {
+	output_putc(']');
+    }
+    free(split.elts);
+
+    return true;
+}
+
+/*
+ * Output obj through one of libucl's emitters
+ */
+static void
+output_emit(const ucl_object_t *obj, const char *nodepath, const char *key)
 {
-    unsigned char *result = NULL;
-    char *key = strdup(inkey);
+    output_record_start(false);
+    if (show_keys == 1 && key[0] != '\0')
+	output_keyprefix(nodepath, key, shvars);
+    if (obj == NULL) {
+	/* ucl_object_emit() had nothing to return */
+	output_str(NULL);
+    } else if (!emit_parallel(obj)) {
+	ucl_object_emit_full(obj, output_type, &output_emitter, NULL);
+    }
+    output_record_end();
+}
 
-    if (shvars == true) {
-	replace_sep(nodepath, '.', '_');
+/*
+ * Output obj as JSON with the native emitter, see uclcmd_json.c
+ */
+static void
+output_json(const ucl_object_t *obj, const char *nodepath, const char *key)
+{
+    output_record_start(false);
+    if (show_keys == 1 && key[0] != '\0')
+	output_keyprefix(nodepath, key, shvars);
+    if (obj == NULL) {
+	output_str(NULL);
+    } else {
+	json_emit(obj, output_type == UCL_EMIT_JSON_COMPACT);
     }
-    replace_sep(nodepath, input_sepchar, output_sepchar);
-    replace_sep(key, input_sepchar, output_sepchar);
+    output_record_end();
+}
 
+/*
+ * Output one self-contained JSON line per result, for --ndjson
+ */
+static void
+output_ndjson(const ucl_object_t *obj, const char *nodepath, const char *key)
+{
+    output_record_start(false);
+    json_record(obj, nodepath, key);
+    output_record_end();
+    output_tick();
+}
+
+static void
+output_invalid(const ucl_object_t *obj, const char *nodepath,
+    const char *key)
+{
+}
+
+/* Picked by output_init() from output_type, once per run */
+static output_func_t output_func = output_text;
+
+/*
+ * Choose how output_chunk() formats values, once the options that decide
+ * it have been parsed
+ */
+void
+output_init()
+{
+    if (records != RECORDS_TEXT) {
+	/* Records are delimited unambiguously, so need no quoting */
+	nonewline = 0;
+	show_raw = 1;
+    }
     switch (output_type) {
     case 254: /* Text */
-	output_key(obj, nodepath, key);
+	output_func = output_text;
 	break;
     case UCL_EMIT_CONFIG: /* UCL */
-	result = ucl_object_emit(obj, output_type);
 	if (nonewline) {
 	    fprintf(stderr, "WARN: UCL output cannot be 'nonewline'd\n");
 	}
-	if (show_keys == 1 && strlen(key) > 0)
-	    printf("%s%s=", nodepath, key);
-	printf("%s", result);
-	free(result);
-	if (nonewline) {
-	    firstline = false;
-	} else {
-	    printf("\n");
-	}
+	output_func = output_emit;
 	break;
     case UCL_EMIT_JSON: /* JSON */
-	result = ucl_object_emit(obj, output_type);
 	if (nonewline) {
 	    fprintf(stderr,
 		"WARN: non-compact JSON output cannot be 'nonewline'd\n");
 	}
-	if (show_keys == 1 && strlen(key) > 0)
-	    printf("%s%s=", nodepath, key);
-	printf("%s", result);
-	free(result);
-	if (nonewline) {
-	    firstline = false;
-	} else {
-	    printf("\n");
-	}
+	output_func = output_json;
 	break;
     case UCL_EMIT_JSON_COMPACT: /* Compact JSON */
-	result = ucl_object_emit(obj, output_type);
-	if (show_keys == 1 && strlen(key) > 0)
-	    printf("%s%s=", nodepath, key);
-	printf("%s", result);
-	free(result);
-	if (nonewline) {
-	    firstline = false;
-	} else {
-	    printf("\n");
-	}
+	output_func = output_json;
+	break;
+    case OUTPUT_NDJSON: /* Newline delimited JSON */
+	nonewline = 0;
+	output_func = output_ndjson;
 	break;
     case UCL_EMIT_YAML: /* YAML */
-	result = ucl_object_emit(obj, output_type);
 	if (nonewline) {
 	    fprintf(stderr, "WARN: YAML output cannot be 'nonewline'd\n");
 	}
-	if (show_keys == 1 && strlen(key) > 0)
-	    printf("%s%s=", nodepath, key);
-	printf("%s", result);
-	free(result);
-	if (nonewline) {
-	    firstline = false;
-	} else {
-	    printf("\n");
-	}
+	output_func = output_emit;
 	break;
     default:
 	fprintf(stderr, "Error: Invalid output mode: %i\n",
 	    output_type);
+	output_func = output_invalid;
 	break;
     }
-
-    free(key);
 }
 
 void
-output_key(const ucl_object_t *obj, char *nodepath, const char *inkey)
+output_chunk(const ucl_object_t *obj, const char *nodepath, const char *key)
 {
-    char *key;
-
-    if (inkey == NULL) {
-	asprintf(&key, "");
-    } else {
-	key = strdup(inkey);
-    }
+    output_func(obj, nodepath, key);
+}
 
-    replace_sep(nodepath, input_sepchar, output_sepchar);
-    replace_sep(key, input_sepchar, output_sepchar);
-    if (firstline == false) {
-	printf(" ");
-    }
-    if (obj == NULL) {
-	if (show_keys == 1) {
-	    printf("%s%s=", nodepath, key);
-	}
-	printf("null");
-	if (nonewline) {
-	    firstline = false;
-	} else {
-	    printf("\n");
-	}
+void
+output_key(const ucl_object_t *obj, const char *nodepath, const char *key)
+{
+    if (output_type == OUTPUT_NDJSON) {
+	output_ndjson(obj, nodepath, key);
 	return;
     }
+    output_key_common(obj, nodepath, key, false);
+}
+
+/*
+ * Debugging description of a value about to be output
+ */
+static void
+output_debug(const ucl_object_t *obj)
+{
     switch (ucl_object_type(obj)) {
     case UCL_OBJECT:
-	if (debug >= 3) {
-	    fprintf(stderr, "DEBUG: key=%s\nlen=%u\ntype=UCL_OBJECT\n"
-		"value={object}\n", obj->key, obj->len);
-	}
-	if (show_keys == 1)
-	    printf("%s%s=", nodepath, key);
-	printf("{object}");
+	fprintf(stderr, "DEBUG: key=%s\nlen=%u\ntype=UCL_OBJECT\n"
+	    "value={object}\n", obj->key, obj->len);
 	break;
     case UCL_ARRAY:
-	if (debug >= 3) {
-	    fprintf(stderr, "DEBUG: key=%s\nlen=%u\ntype=UCL_ARRAY\n"
-		"value=[array]\n", obj->key, obj->len);
-	}
-	if (show_keys == 1)
-	    printf("%s%s=", nodepath, key);
-	printf("[array]");
+	fprintf(stderr, "DEBUG: key=%s\nlen=%u\ntype=UCL_ARRAY\n"
+	    "value=[array]\n", obj->key, obj->len);
 	break;
     case UCL_INT:
-	if (debug >= 3) {
-	    fprintf(stderr, "DEBUG: key=%s\nlen=%u\ntype=UCL_INT\nvalue=%jd\n",
-		obj->key, obj->len, (intmax_t)ucl_object_toint(obj));
-	}
-	if (show_keys == 1)
-	    printf("%s%s=", nodepath, key);
-	printf("%jd", (intmax_t)ucl_object_toint(obj));
+	fprintf(stderr, "DEBUG: key=%s\nlen=%u\ntype=UCL_INT\nvalue=%jd\n",
+	    obj->key, obj->len, (intmax_t)ucl_object_toint(obj));
 	break;
     case UCL_FLOAT:
-	if (debug >= 3) {
-	    fprintf(stderr, "DEBUG: key=%s\nlen=%u\ntype=UCL_FLOAT\nvalue=%f\n",
-		obj->key, obj->len, ucl_object_todouble(obj));
-	}
-	if (show_keys == 1)
-	    printf("%s%s=", nodepath, key);
-	printf("%f", ucl_object_todouble(obj));
+	fprintf(stderr, "DEBUG: key=%s\nlen=%u\ntype=UCL_FLOAT\nvalue=%f\n",
+	    obj->key, obj->len, ucl_object_todouble(obj));
 	break;
     case UCL_STRING:
-	if (debug >= 3) {
-	    fprintf(stderr, "DEBUG: key=%s\nlen=%u\ntype=UCL_STRING\n"
-		"value=\"%s\"\n", obj->key, obj->len, ucl_object_tostring(obj));
-	}
-	if (show_keys == 1)
-	    printf("%s%s=", nodepath, key);
-	if (show_raw == 1)
-	    printf("%s", ucl_object_tostring(obj));
-	else
-	    printf("\"%s\"", ucl_object_tostring(obj));
+	fprintf(stderr, "DEBUG: key=%s\nlen=%u\ntype=UCL_STRING\n"
+	    "value=\"%s\"\n", obj->key, obj->len, ucl_object_tostring(obj));
 	break;
     case UCL_BOOLEAN:
-	if (debug >= 3) {
-	    fprintf(stderr, "DEBUG: key=%s\nlen=%u\ntype=UCL_BOOLEAN\n"
-		"value=%s\n", obj->key, obj->len,
-		ucl_object_tostring_forced(obj));
-	}
-	if (show_keys == 1)
-	    printf("%s%s=", nodepath, key);
-	printf("%s", ucl_object_tostring_forced(obj));
+	fprintf(stderr, "DEBUG: key=%s\nlen=%u\ntype=UCL_BOOLEAN\n"
+	    "value=%s\n", obj->key, obj->len,
+	    ucl_object_tostring_forced(obj));
 	break;
     case UCL_TIME:
-	if (debug >= 3) {
-	    fprintf(stderr, "DEBUG: key=%s\nlen=%u\ntype=UCL_TIME\nvalue=%f\n",
-		obj->key, obj->len, ucl_object_todouble(obj));
-	}
-	if (show_keys == 1)
-	    printf("%s%s=", nodepath, key);
-	printf("%f", ucl_object_todouble(obj));
+	fprintf(stderr, "DEBUG: key=%s\nlen=%u\ntype=UCL_TIME\nvalue=%f\n",
+	    obj->key, obj->len, ucl_object_todouble(obj));
 	break;
     case UCL_USERDATA:
-	if (debug >= 3) {
-	    fprintf(stderr, "DEBUG: key=%s\nlen=%u\ntype=UCL_USERDATA\n"
-		"value=%p\n", obj->key, obj->len, obj->value.ud);
-	}
-	if (show_keys == 1)
-	    printf("%s%s=", nodepath, key);
-	printf("{userdata}");
+	fprintf(stderr, "DEBUG: key=%s\nlen=%u\ntype=UCL_USERDATA\n"
+	    "value=%p\n", obj->key, obj->len, obj->value.ud);
 	break;
     default:
-	if (debug >= 3) {
-	    printf("error=Object of unknown type\n");
-	    fprintf(stderr, "DEBUG: key=%s\nlen=%u\ntype=UCL_ERROR\n"
-		"value=null\n", obj->key, obj->len);
-	}
+	output_puts("error=Object of unknown type\n");
+	fprintf(stderr, "DEBUG: key=%s\nlen=%u\ntype=UCL_ERROR\n"
+	    "value=null\n", obj->key, obj->len);
 	break;
     }
-    if (nonewline) {
-	firstline = false;
+}
+
+/*
+ * shellvars is set when called from output_chunk(), which also applies the
+ * --shellvars translation to the node path
+ */
+static void
+output_key_common(const ucl_object_t *obj, const char *nodepath,
+    const char *key, bool shellvars)
+{
+    const char *str = NULL;
+    size_t len;
+
+    if (key == NULL) {
+	key = "";
+    }
+
+    output_record_start(true);
+    if (obj != NULL && debug >= 3) {
+	output_debug(obj);
+    }
+    if (show_keys == 1)
+	output_keyprefix(nodepath, key, shellvars);
+    if (export_prefix != NULL) {
+	/* Every value is a single quoted word */
+	output_putc('\'');
+    }
+    if (obj == NULL) {
+	output_write("null", 4);
     } else {
-	printf("\n");
+	switch (ucl_object_type(obj)) {
+	case UCL_OBJECT:
+	    output_write("{object}", 8);
+	    break;
+	case UCL_ARRAY:
+	    output_write("[array]", 7);
+	    break;
+	case UCL_INT:
+	    output_int(ucl_object_toint(obj));
+	    break;
+	case UCL_FLOAT:
+	case UCL_TIME:
+	    output_double(ucl_object_todouble(obj), false);
+	    break;
+	case UCL_STRING:
+	    /*
+	     * Zero-copy strings are not NUL terminated, and tostring would
+	     * make a terminated copy of every one printed
+	     */
+	    str = ucl_object_tolstring(obj, &len);
+	    if (str == NULL) {
+		str = "(null)";
+		len = 6;
+	    }
+	    if (export_prefix != NULL) {
+		output_shquote(str, len);
+	    } else if (show_raw == 1) {
+		output_write(str, len);
+	    } else {
+		output_putc('"');
+		output_write(str, len);
+		output_putc('"');
+	    }
+	    break;
+	case UCL_BOOLEAN:
+	    output_str(ucl_object_tostring_forced(obj));
+	    break;
+	case UCL_USERDATA:
+	    output_write("{userdata}", 10);
+	    break;
+	default:
+	    break;
+	}
+    }
+    if (export_prefix != NULL) {
+	output_putc('\'');
     }
+    output_record_end();
+}
+
+/*
+ * Print the fields of one element of a dumped node, indented for shift
+ */
+static void
+ucl_obj_dump_node(const ucl_object_t *obj, const ucl_object_t *cur,
+    unsigned int shift)
+{
+    int pre = shift * 2 + 4;
 
-    free(key);
+    output_printf("%*sucl object address: %p\n", pre - 4, "", obj);
+    if (cur->key != NULL) {
+	output_printf("%*skey: \"%s\"\n", pre, "", ucl_object_key (cur));
+    }
+    output_printf("%*sref: %u\n", pre, "", cur->ref);
+    output_printf("%*slen: %u\n", pre, "", cur->len);
+    output_printf("%*sprev: %p\n", pre, "", cur->prev);
+    output_printf("%*snext: %p\n", pre, "", cur->next);
+    output_printf("%*spriority: %d\n", pre, "", (cur->flags >> ((sizeof (cur->flags) * 8) - 4)));
+    output_printf("%*sflags: %x\n", pre, "", (cur->flags & 0xfff));
+    if (ucl_object_type(cur) == UCL_OBJECT) {
+	output_printf("%*stype: UCL_OBJECT\n", pre, "");
+	output_printf("%*svalue: %p\n", pre, "", cur->value.ov);
+    }
+    else if (ucl_object_type(cur) == UCL_ARRAY) {
+	output_printf("%*stype: UCL_ARRAY\n", pre, "");
+	output_printf("%*svalue: %p\n", pre, "", cur->value.av);
+    }
+    else if (ucl_object_type(cur) == UCL_INT) {
+	output_printf("%*stype: UCL_INT\n", pre, "");
+	output_printf("%*svalue: %jd\n", pre, "", (intmax_t)ucl_object_toint (cur));
+    }
+    else if (ucl_object_type(cur) == UCL_FLOAT) {
+	output_printf("%*stype: UCL_FLOAT\n", pre, "");
+	output_printf("%*svalue: %f\n", pre, "", ucl_object_todouble (cur));
+    }
+    else if (ucl_object_type(cur) == UCL_STRING) {
+	output_printf("%*stype: UCL_STRING\n", pre, "");
+	output_printf("%*svalue: \"%s\"\n", pre, "", ucl_object_tostring (cur));
+    }
+    else if (ucl_object_type(cur) == UCL_BOOLEAN) {
+	output_printf("%*stype: UCL_BOOLEAN\n", pre, "");
+	output_printf("%*svalue: %s\n", pre, "", ucl_object_tostring_forced (cur));
+    }
+    else if (ucl_object_type(cur) == UCL_TIME) {
+	output_printf("%*stype: UCL_TIME\n", pre, "");
+	output_printf("%*svalue: %f\n", pre, "", ucl_object_todouble (cur));
+    }
+    else if (ucl_object_type(cur) == UCL_USERDATA) {
+	output_printf("%*stype: UCL_USERDATA\n", pre, "");
+	output_printf("%*svalue: %p\n", pre, "", cur->value.ud);
+    }
 }
 
+/*
+ * Dump obj and everything below it. As with ucl_object_iterate_safe(), the
+ * elements of a frame are the children of its node when that is a
+ * container, and each element that is itself a container has its children
+ * dumped, every one in a frame of its own.
+ */
 void
 ucl_obj_dump(const ucl_object_t *obj, unsigned int shift)
 {
-    int num = shift * 2 + 5;
-    char *pre = (char *) malloc (num * sizeof(char));
-    const ucl_object_t *cur, *cur2;
-    ucl_object_iter_t it = NULL, it2 = NULL;
+    walk_t walk;
+    walk_frame_t *frame = NULL;
+    const ucl_object_t *cur;
+    int level;
 
-    it = ucl_object_iterate_new(obj);
-    it2 = ucl_object_iterate_new(obj);
+    memset(&walk, 0, sizeof(walk));
+    frame = walk_push(&walk, obj);
+    frame->chain = obj;
+    frame->level = shift;
 
-    pre[--num] = 0x00;
-    while (num--)
-	    pre[num] = 0x20;
-
-    while ((cur = ucl_object_iterate_safe(it, false))) {
-	printf ("%sucl object address: %p\n", pre + 4, obj);
-	if (cur->key != NULL) {
-	    printf ("%skey: \"%s\"\n", pre, ucl_object_key (cur));
-	}
-	printf ("%sref: %u\n", pre, cur->ref);
-	printf ("%slen: %u\n", pre, cur->len);
-	printf ("%sprev: %p\n", pre, cur->prev);
-	printf ("%snext: %p\n", pre, cur->next);
-	printf ("%spriority: %d\n", pre, (cur->flags >> ((sizeof (cur->flags) * 8) - 4)));
-	printf ("%sflags: %x\n", pre, (cur->flags & 0xfff));
-	if (ucl_object_type(cur) == UCL_OBJECT) {
-	    printf ("%stype: UCL_OBJECT\n", pre);
-	    printf ("%svalue: %p\n", pre, cur->value.ov);
-	    it2 = ucl_object_iterate_reset (it2, cur);
-	    while ((cur2 = ucl_object_iterate_safe(it2, true))) {
-		ucl_obj_dump (cur2, shift + 2);
+    while (walk.depth > 0) {
+	frame = &walk.frames[walk.depth - 1];
+	if (frame->cur != NULL) {
+	    cur = walk_iter_next(&frame->sub, &frame->subit);
+	    if (cur != NULL) {
+		level = frame->level + 2;
+		frame = walk_push(&walk, cur);
+		frame->chain = cur;
+		frame->level = level;
+		continue;
 	    }
+	    frame->cur = NULL;
 	}
-	else if (ucl_object_type(cur) == UCL_ARRAY) {
-	    printf ("%stype: UCL_ARRAY\n", pre);
-	    printf ("%svalue: %p\n", pre, cur->value.av);
-	    it2 = ucl_object_iterate_reset (it2, cur);
-	    while ((cur2 = ucl_object_iterate_safe(it2, true))) {
-		ucl_obj_dump (cur2, shift + 2);
-	    }
-	}
-	else if (ucl_object_type(cur) == UCL_INT) {
-	    printf ("%stype: UCL_INT\n", pre);
-	    printf ("%svalue: %jd\n", pre, (intmax_t)ucl_object_toint (cur));
-	}
-	else if (ucl_object_type(cur) == UCL_FLOAT) {
-	    printf ("%stype: UCL_FLOAT\n", pre);
-	    printf ("%svalue: %f\n", pre, ucl_object_todouble (cur));
-	}
-	else if (ucl_object_type(cur) == UCL_STRING) {
-	    printf ("%stype: UCL_STRING\n", pre);
-	    printf ("%svalue: \"%s\"\n", pre, ucl_object_tostring (cur));
-	}
-	else if (ucl_object_type(cur) == UCL_BOOLEAN) {
-	    printf ("%stype: UCL_BOOLEAN\n", pre);
-	    printf ("%svalue: %s\n", pre, ucl_object_tostring_forced (cur));
-	}
-	else if (ucl_object_type(cur) == UCL_TIME) {
-	    printf ("%stype: UCL_TIME\n", pre);
-	    printf ("%svalue: %f\n", pre, ucl_object_todouble (cur));
+	cur = walk_iter_next(&frame->chain, &frame->it);
+	if (cur == NULL) {
+	    walk_pop(&walk);
+	    continue;
 	}
-	else if (ucl_object_type(cur) == UCL_USERDATA) {
-	    printf ("%stype: UCL_USERDATA\n", pre);
-	    printf ("%svalue: %p\n", pre, cur->value.ud);
+	ucl_obj_dump_node(frame->obj, cur, frame->level);
+	if (ucl_object_type(cur) == UCL_OBJECT ||
+	    ucl_object_type(cur) == UCL_ARRAY) {
+	    frame->cur = frame->sub = cur;
+	    frame->subit = NULL;
 	}
     }
 
-    ucl_object_iterate_free (it);
-    free (pre);
+    walk_free(&walk);
 }
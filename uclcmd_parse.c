@@ -26,29 +26,157 @@
  * $FreeBSD$
  */
 
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
 #include "uclcmd.h"
 
+#define INPUT_CHUNK_SIZE	65536
+
+/*
+ * Input buffers the parsers were fed. Those parsed with
+ * UCLCMD_ZEROCOPY_FLAGS have string values pointing straight into them, so
+ * they must outlive every object parsed from them.
+ */
+struct input_buf {
+    void *data;
+    size_t len;
+    bool mapped;
+    struct input_buf *next;
+};
+static struct input_buf *input_bufs = NULL;
+
+void
+retain_input(void *data, size_t len, bool mapped)
+{
+    struct input_buf *ib;
+
+    ib = malloc(sizeof(*ib));
+    if (ib == NULL) {
+	fprintf(stderr, "Error: Unable to allocate input buffer\n");
+	cleanup();
+	exit(2);
+    }
+    ib->data = data;
+    ib->len = len;
+    ib->mapped = mapped;
+    ib->next = input_bufs;
+    input_bufs = ib;
+}
+
+void
+release_inputs()
+{
+    struct input_buf *ib;
+
+    while ((ib = input_bufs) != NULL) {
+	input_bufs = ib->next;
+	if (ib->mapped) {
+	    munmap(ib->data, ib->len);
+	} else {
+	    free(ib->data);
+	}
+	free(ib);
+    }
+}
+
+/*
+ * Whether the document pulls in other files. libucl unmaps those as soon as
+ * they are parsed, so strings from them must be copied.
+ */
+bool
+input_has_file_macros(const void *data, size_t len)
+{
+
+    return (memmem(data, len, ".include", 8) != NULL ||
+	memmem(data, len, ".try_include", 12) != NULL ||
+	memmem(data, len, ".load", 5) != NULL);
+}
+
+/*
+ * Pick the parser for a buffer that is kept until release_inputs(). Unless
+ * it uses file macros, parse it with a zero-copy parser of our own; the
+ * tree outlives that parser by reference.
+ */
+static struct ucl_parser*
+input_parser(struct ucl_parser *parser, const void *data, size_t len)
+{
+
+    if (input_has_file_macros(data, len)) {
+	return parser;
+    }
+    return ucl_parser_new(UCLCMD_ZEROCOPY_FLAGS);
+}
+
 ucl_object_t*
 parse_file(struct ucl_parser *parser, const char *filename)
 {
+    struct ucl_parser *p = parser;
     ucl_object_t *obj = NULL;
+    void *data = MAP_FAILED;
+    struct cache_key ckey = { NULL };
+    struct stat sb;
+    int fd;
 
-    ucl_parser_add_file(parser, filename);
+    /*
+     * Map regular files and let the parser reference the mapping directly.
+     * Anything else (pipes, devices, empty files) goes through libucl.
+     */
+    fd = open(filename, O_RDONLY);
+    if (fd != -1) {
+	if (fstat(fd, &sb) == 0 && S_ISREG(sb.st_mode) && sb.st_size > 0) {
+	    data = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	close(fd);
+    }
 
-    if (ucl_parser_get_error(parser)) {
+    if (data != MAP_FAILED) {
+	if (cache_dir != NULL &&
+	    cache_key_init(&ckey, filename, data, &sb)) {
+	    obj = cache_load(&ckey);
+	    if (obj != NULL) {
+		munmap(data, sb.st_size);
+		cache_key_free(&ckey);
+		return obj;
+	    }
+	}
+	retain_input(data, sb.st_size, true);
+	p = input_parser(parser, data, sb.st_size);
+	ucl_parser_set_filevars(p, filename, false);
+	ucl_parser_add_chunk(p, data, sb.st_size);
+    } else {
+	if (debug > 0) {
+	    fprintf(stderr, "DEBUG: Not mapping %s, reading it instead\n",
+		filename);
+	}
+	ucl_parser_add_file(parser, filename);
+    }
+
+    if (ucl_parser_get_error(p)) {
 	fprintf(stderr, "Error occured: %s\n",
-	    ucl_parser_get_error(parser));
+	    ucl_parser_get_error(p));
 	cleanup();
 	exit(2);
     }
 
-    obj = ucl_parser_get_object(parser);
-    if (ucl_parser_get_error(parser)) {
+    obj = ucl_parser_get_object(p);
+    if (ucl_parser_get_error(p)) {
 	fprintf(stderr, "Error: Parse Error occured: %s\n",
-	    ucl_parser_get_error(parser));
+	    ucl_parser_get_error(p));
 	cleanup();
 	exit(3);
     }
+    if (p != parser) {
+	ucl_parser_free(p);
+    }
+
+    if (ckey.path != NULL) {
+	cache_store(&ckey, obj);
+	cache_key_free(&ckey);
+    }
 
     return obj;
 }
@@ -56,34 +184,81 @@ parse_file(struct ucl_parser *parser, const char *filename)
 ucl_object_t*
 parse_input(struct ucl_parser *parser, FILE *source)
 {
-    unsigned char inbuf[8192];
-    char *data = NULL;
-    int r = 0;
+    struct ucl_parser *p = NULL;
+    unsigned char *inbuf = NULL, *tmp = NULL;
+    size_t bufsize = INPUT_CHUNK_SIZE, size = 0, r = 0, n = 0, want;
+    struct stat sb;
     ucl_object_t *obj = NULL;
     bool success = false;
 
-    while (!feof(source) && r < (int)sizeof(inbuf)) {
-	r += fread(inbuf + r, 1, sizeof(inbuf) - r, source);
+    /*
+     * libucl needs the whole document in a single chunk, so read the stream
+     * into one buffer that doubles whenever a read fills it. If the input is
+     * a regular file we know the final size up front, read exactly that and
+     * never reallocate. The parsed objects reference this buffer, so it is
+     * kept until cleanup().
+     */
+    if (fstat(fileno(source), &sb) == 0 && S_ISREG(sb.st_mode) &&
+	sb.st_size > 0) {
+	size = sb.st_size;
+	bufsize = size + 1;
+    }
+    inbuf = malloc(bufsize);
+    if (inbuf == NULL) {
+	fprintf(stderr, "Error: Unable to allocate input buffer\n");
+	cleanup();
+	exit(2);
     }
-    success = ucl_parser_add_chunk(parser, inbuf, r);
+    for (;;) {
+	want = bufsize - r - 1;
+	n = fread(inbuf + r, 1, want, source);
+	r += n;
+	/* fread() only comes up short at EOF or on an error */
+	if (n < want || (size > 0 && r == size)) {
+	    break;
+	}
+	bufsize *= 2;
+	tmp = realloc(inbuf, bufsize);
+	if (tmp == NULL) {
+	    fprintf(stderr, "Error: Unable to allocate input buffer\n");
+	    free(inbuf);
+	    cleanup();
+	    exit(2);
+	}
+	inbuf = tmp;
+    }
+    if (ferror(source)) {
+	fprintf(stderr, "Error: Failed to read input: %s\n", strerror(errno));
+	free(inbuf);
+	cleanup();
+	exit(2);
+    }
+    inbuf[r] = '\0';
     fclose(source);
 
+    p = input_parser(parser, inbuf, r);
+    success = ucl_parser_add_chunk(p, inbuf, r);
+
     if (success == false) {
 	/* There must be a better way to detect a string */
-	ucl_parser_clear_error(parser);
+	ucl_parser_clear_error(p);
 	success = true;
-	asprintf(&data, "%s", inbuf);
-	obj = ucl_object_fromstring_common(data, 0, UCL_STRING_PARSE);
+	obj = ucl_object_fromstring_common((char *)inbuf, r, UCL_STRING_PARSE);
+	free(inbuf);
     } else {
-	obj = ucl_parser_get_object(parser);
+	obj = ucl_parser_get_object(p);
+	retain_input(inbuf, bufsize, false);
     }
 
-    if (ucl_parser_get_error(parser)) {
+    if (ucl_parser_get_error(p)) {
 	fprintf(stderr, "Error: Parse Error occured: %s\n",
-	    ucl_parser_get_error(parser));
+	    ucl_parser_get_error(p));
 	cleanup();
 	exit(3);
     }
+    if (p != parser) {
+	ucl_parser_free(p);
+    }
 
     return obj;
 }
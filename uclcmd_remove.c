@@ -28,20 +28,64 @@
 
 #include "uclcmd.h"
 
+/*
+ * Remove every node a wildcard path selects. Matches are collected before
+ * anything is removed, then removed last to first, so a node is always
+ * removed before any of its ancestors.
+ */
+static bool
+remove_wild(const keypath_t *path)
+{
+    keypath_match_t *matches = NULL;
+    ucl_object_t *parent = NULL, *obj_temp = NULL;
+    size_t nmatches, i;
+    bool success = false;
+
+    matches = keypath_collect(&scratch, root_obj, path, &nmatches);
+    for (i = nmatches; i-- > 0;) {
+	parent = __DECONST(ucl_object_t *, matches[i].parent);
+	if (parent == NULL) {
+	    /* The root itself, as selected by ** */
+	    continue;
+	}
+	if (ucl_object_type(parent) == UCL_ARRAY) {
+	    obj_temp = ucl_array_delete(parent,
+		__DECONST(ucl_object_t *, matches[i].obj));
+	    if (obj_temp != NULL) {
+		ucl_object_unref(obj_temp);
+		success = true;
+	    }
+	} else if (matches[i].key != NULL &&
+	    ucl_object_delete_key(parent, matches[i].key)) {
+	    success = true;
+	}
+    }
+    if (debug > 0) {
+	fprintf(stderr, "DEBUG: Removed %zu nodes matching %s\n", nmatches,
+	    path->str);
+    }
+
+    path_index_free();
+    return success;
+}
+
 int
 remove_main(int argc, char *argv[])
 {
     const char *filename = NULL;
     int ret = 0, k = 0, ch;
     ucl_object_t *obj_parent = NULL, *obj_child = NULL, *obj_temp = NULL;
+    arena_mark_t mark;
+    keypath_t path;
+    node_ref_t ref;
     bool success = false;
 
     /* Initialize parser */
-    parser = ucl_parser_new(UCL_PARSER_KEY_LOWERCASE |
-        UCL_PARSER_NO_IMPLICIT_ARRAYS);
+    parser = ucl_parser_new(UCLCMD_PARSER_FLAGS);
 
     /*	options	descriptor */
     static struct option longopts[] = {
+	{ "cache",	optional_argument,	NULL,		'C' },
 	{ "cjson",	no_argument,		&output_type,
 	    UCL_EMIT_JSON_COMPACT },
 	{ "debug",	optional_argument,	NULL,		'd' },
@@ -79,14 +123,11 @@ remove_main(int argc, char *argv[])
 	case 'e':
 	    expand = 1;
 	    break;
+	case 'C':
+	    cache_init(optarg);
+	    break;
 	case 'f':
 	    filename = optarg;
-	    if (strcmp(optarg, "-") == 0) {
-		/* Input from STDIN */
-		root_obj = parse_input(parser, stdin);
-	    } else {
-		root_obj = parse_file(parser, filename);
-	    }
 	    break;
 	case 'j':
 	    output_type = UCL_EMIT_JSON;
@@ -119,29 +160,41 @@ remove_main(int argc, char *argv[])
     }
     argc -= optind;
     argv += optind;
+    output_init();
 
     if (argc == 0) {
 	usage();
     }
 
     /* Parse the original UCL */
-    if (filename == NULL) {
+    if (filename == NULL || strcmp(filename, "-") == 0) {
+	/* Input from STDIN */
 	root_obj = parse_input(parser, stdin);
+    } else {
+	root_obj = parse_file(parser, filename);
     }
 
     for (k = 0; k < argc; k++) {
 	success = false;
 
-	obj_parent = get_parent(argv[k]);
-	if (obj_parent == NULL) {
-	    fprintf(stderr, "Failed to find parent of key %s, skipping...\n", argv[k]);
+	mark = arena_mark(&scratch);
+	keypath_compile(&scratch, &path, argv[k]);
+	if (path.wild) {
+	    if (!remove_wild(&path)) {
+		fprintf(stderr, "Failed to remove key %s\n", argv[k]);
+	    }
+	    arena_release(&scratch, mark);
 	    continue;
 	}
-	obj_child = get_object(argv[k]);
-	if (obj_child == NULL) {
-	    fprintf(stderr, "Failed to find key %s, skipping...\n", argv[k]);
+	arena_release(&scratch, mark);
+
+	if (!resolve_path(argv[k], &ref)) {
+	    fprintf(stderr, "Failed to find parent of key %s, skipping...\n", argv[k]);
+	    node_ref_free(&ref);
 	    continue;
 	}
+	obj_parent = ref.parent;
+	obj_child = ref.child;
 
 	/* if parent is an array, special case */
 	if (ucl_object_type(obj_parent) == UCL_ARRAY) {
@@ -163,18 +216,24 @@ remove_main(int argc, char *argv[])
 		success = ucl_object_delete_key(obj_parent, ucl_object_key(obj_child));
 	    } else {
 		fprintf(stderr, "Failed to get key for '%s', skipping...\n", argv[k]);
+		node_ref_free(&ref);
 		continue;
 	    }
 	} else {
 	    fprintf(stderr, "Invalid parent object type for '%s', skipping...\n", argv[k]);
+	    node_ref_free(&ref);
 	    continue;
 	}
 
 	if (!success) {
 	    fprintf(stderr, "Failed to remove key %s\n", argv[k]);
-	} else if (debug > 0) {
-	    fprintf(stderr, "DEBUG: Removed node %s\n", argv[k]);
+	} else {
+	    path_index_invalidate(&ref);
+	    if (debug > 0) {
+		fprintf(stderr, "DEBUG: Removed node %s\n", argv[k]);
+	    }
 	}
+	node_ref_free(&ref);
     }
     get_mode("");
 
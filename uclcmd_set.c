@@ -36,11 +36,11 @@ set_main(int argc, char *argv[])
     bool success = false;
 
     /* Initialize parser */
-    parser = ucl_parser_new(UCL_PARSER_KEY_LOWERCASE |
-        UCL_PARSER_NO_IMPLICIT_ARRAYS);
+    parser = ucl_parser_new(UCLCMD_PARSER_FLAGS);
 
     /*	options	descriptor */
     static struct option longopts[] = {
+	{ "cache",	optional_argument,	NULL,		'C' },
 	{ "cjson",	no_argument,		&output_type,
 	    UCL_EMIT_JSON_COMPACT },
 	{ "debug",	optional_argument,	NULL,		'd' },
@@ -79,14 +79,11 @@ set_main(int argc, char *argv[])
 	case 'e':
 	    expand = 1;
 	    break;
+	case 'C':
+	    cache_init(optarg);
+	    break;
 	case 'f':
 	    filename = optarg;
-	    if (strcmp(optarg, "-") == 0) {
-		/* Input from STDIN */
-		root_obj = parse_input(parser, stdin);
-	    } else {
-		root_obj = parse_file(parser, filename);
-	    }
 	    break;
 	case 'i':
 	    include_file = optarg;
@@ -122,13 +119,17 @@ set_main(int argc, char *argv[])
     }
     argc -= optind;
     argv += optind;
+    output_init();
 
     if (argc == 0) {
 	usage();
     }
 
-    if (filename == NULL) {
+    if (filename == NULL || strcmp(filename, "-") == 0) {
+	/* Input from STDIN */
 	root_obj = parse_input(parser, stdin);
+    } else {
+	root_obj = parse_file(parser, filename);
     }
 
     if (argc > 1) { 
@@ -152,46 +153,159 @@ set_main(int argc, char *argv[])
     return(ret);
 }
 
+/*
+ * Parse the UCL to be written into set_obj
+ */
+static void
+set_parse(char *data)
+{
+    if (include_file != NULL) {
+	/* get UCL to add from file */
+	set_obj = parse_file(setparser, include_file);
+    } else if (data == NULL || strcmp(data, "-") == 0) {
+	/* get UCL to add from stdin */
+	set_obj = parse_input(setparser, stdin);
+    } else {
+	/* User provided data inline */
+	set_obj = parse_string(setparser, data);
+    }
+}
+
+/*
+ * Write a copy of set_obj to key or index in dst_obj, creating the key if
+ * it does not exist yet. Array elements can only be replaced, and only if
+ * is_index says the destination names one.
+ */
+static bool
+set_child(ucl_object_t *dst_obj, const char *key, unsigned long index,
+    bool is_index)
+{
+    ucl_object_t *copy = NULL, *old_obj = NULL;
+
+    if (ucl_object_type(dst_obj) == UCL_ARRAY && !is_index) {
+	return false;
+    }
+    copy = ucl_object_copy(set_obj);
+    if (ucl_object_type(dst_obj) == UCL_ARRAY) {
+	if (debug > 0) {
+	    fprintf(stderr, "Replacing array index %lu\n", index);
+	}
+	old_obj = ucl_array_replace_index(dst_obj, copy, index);
+	if (old_obj == NULL) {
+	    ucl_object_unref(copy);
+	    return false;
+	}
+	ucl_object_unref(old_obj);
+	return true;
+    }
+    if (ucl_object_type(dst_obj) != UCL_OBJECT || key == NULL) {
+	ucl_object_unref(copy);
+	return false;
+    }
+    if (debug > 0) {
+	fprintf(stderr, "Replacing key %s\n", key);
+    }
+    return ucl_object_replace_key(dst_obj, copy, key, 0, true);
+}
+
+/*
+ * Set every node a wildcard destination selects. When the last element is
+ * a plain key it is set in every node the rest of the path matches, which
+ * creates it where it is missing, otherwise only existing nodes are
+ * replaced. Matches are handled last to first, so a node is always written
+ * before any of its ancestors can be replaced.
+ */
+static int
+set_wild(keypath_t *path, char *data)
+{
+    keypath_match_t *matches = NULL;
+    keyseg_t *last = &path->segs[path->nsegs - 1];
+    ucl_object_t *dst_obj = NULL;
+    unsigned long index;
+    size_t nmatches, i;
+    bool is_index;
+    int success = false;
+
+    if (last->is_deep) {
+	fprintf(stderr, "Error: ** cannot end a set destination\n");
+	return false;
+    }
+
+    set_parse(data);
+    if (!last->is_glob && !last->is_slice) {
+	path->nsegs--;
+	matches = keypath_collect(&scratch, root_obj, path, &nmatches);
+	path->nsegs++;
+	for (i = nmatches; i-- > 0;) {
+	    dst_obj = __DECONST(ucl_object_t *, matches[i].obj);
+	    index = last->index;
+	    is_index = last->is_index;
+	    if (last->is_neg && ucl_object_type(dst_obj) == UCL_ARRAY) {
+		is_index = keyseg_index(dst_obj, last, &index);
+	    }
+	    if (set_child(dst_obj, last->key, index, is_index)) {
+		success = true;
+	    }
+	}
+    } else {
+	matches = keypath_collect(&scratch, root_obj, path, &nmatches);
+	for (i = nmatches; i-- > 0;) {
+	    if (matches[i].parent == NULL) {
+		continue;
+	    }
+	    if (set_child(__DECONST(ucl_object_t *, matches[i].parent),
+		matches[i].key, matches[i].index, true)) {
+		success = true;
+	    }
+	}
+    }
+
+    if (debug > 0) {
+	fprintf(stderr, "Set %zu nodes matching %s\n", nmatches, path->str);
+    }
+    path_index_free();
+    return success;
+}
+
 int
 set_mode(char *destination_node, char *data)
 {
     ucl_object_t *dst_obj = NULL;
     ucl_object_t *sub_obj = NULL;
     ucl_object_t *old_obj = NULL;
+    arena_mark_t mark;
+    keypath_t path;
+    node_ref_t ref;
     int success = 0;
 
-    setparser = ucl_parser_new(UCL_PARSER_KEY_LOWERCASE |
-	UCL_PARSER_NO_IMPLICIT_ARRAYS);
+    setparser = ucl_parser_new(UCLCMD_PARSER_FLAGS);
 
-    /* Lookup the destination to write to */
-    dst_obj = get_parent(destination_node);
-    sub_obj = get_object(destination_node);
+    mark = arena_mark(&scratch);
+    keypath_compile(&scratch, &path, destination_node);
+    if (path.wild) {
+	success = set_wild(&path, data);
+	arena_release(&scratch, mark);
+	return success;
+    }
+    arena_release(&scratch, mark);
 
-    if (sub_obj == NULL) {
+    /* Lookup the destination to write to */
+    if (!resolve_path(destination_node, &ref)) {
+	node_ref_free(&ref);
 	return false;
     }
+    dst_obj = ref.parent;
+    sub_obj = ref.child;
 
-    if (include_file != NULL) {
-	/* get UCL to add from file */
-	set_obj = parse_file(setparser, include_file);
-    } else if (data == NULL || strcmp(data, "-") == 0) {
-	/* get UCL to add from stdin */
-	set_obj = parse_input(setparser, stdin);
-    } else {
-	/* User provided data inline */
-	set_obj = parse_string(setparser, data);
-    }
+    set_parse(data);
 
     if (debug > 0) {
-	char *rt = NULL, *dt = NULL, *st = NULL;
+	const char *rt = NULL, *dt = NULL, *st = NULL;
 	rt = type_as_string(dst_obj);
 	dt = type_as_string(sub_obj);
 	st = type_as_string(set_obj);
 	fprintf(stderr, "root type: %s, destination type: %s, new type: %s\n",
 	    rt, dt, st);
-	if (rt != NULL) free(rt);
-	if (dt != NULL) free(dt);
-	if (st != NULL) free(st);
 
 	fprintf(stderr, "Inserting key %s to root: %s\n",
 	    ucl_object_key(sub_obj), ucl_object_key(dst_obj));
@@ -199,16 +313,12 @@ set_mode(char *destination_node, char *data)
 
     /* Replace it in the object here */
     if (ucl_object_type(dst_obj) == UCL_ARRAY) {
-	char *dst_frag = strrchr(destination_node, input_sepchar);
-
 	/* XXX TODO: What if the destination_node only points to an array */
 	/* XXX TODO: What if we want to replace an entire array? */
-	dst_frag++;
 	if (debug > 0) {
-	    fprintf(stderr, "Replacing array index %s\n", dst_frag);
+	    fprintf(stderr, "Replacing array index %lu\n", ref.index);
 	}
-	old_obj = ucl_array_replace_index(dst_obj, set_obj, strtoul(dst_frag,
-	    NULL, 0));
+	old_obj = ucl_array_replace_index(dst_obj, set_obj, ref.index);
 	success = false;
 	if (old_obj != NULL) {
 	    ucl_object_unref(old_obj);
@@ -224,5 +334,9 @@ set_mode(char *destination_node, char *data)
 	set_obj = NULL;
     }
 
+    if (success) {
+	path_index_invalidate(&ref);
+    }
+    node_ref_free(&ref);
     return success;
 }
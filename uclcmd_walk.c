@@ -0,0 +1,150 @@
+/*-
+ * Copyright (c) 2014-2015 Allan Jude <allanjude@freebsd.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#include "uclcmd.h"
+
+/*
+ * Explicit frame stack for depth-first traversals.
+ *
+ * Walking a document by recursing on the C stack limits the nesting depth
+ * to whatever the stack happens to allow, and machine generated configs
+ * can nest far deeper than that. The traversals here instead keep one
+ * walk_frame_t per level in a heap array that doubles as it grows, so a
+ * walk costs sizeof(walk_frame_t) bytes per level of nesting and fails
+ * cleanly at WALK_MAX_DEPTH rather than overflowing the stack.
+ */
+
+walk_frame_t*
+walk_push(walk_t *walk, const ucl_object_t *obj)
+{
+    walk_frame_t *frame;
+
+    if (walk->depth == walk->size) {
+	if (walk->size >= WALK_MAX_DEPTH) {
+	    fprintf(stderr, "Error: document is nested more than %d levels "
+		"deep\n", WALK_MAX_DEPTH);
+	    cleanup();
+	    exit(1);
+	}
+	walk->size = walk->size ? walk->size * 2 : 64;
+	walk->frames = realloc(walk->frames,
+	    walk->size * sizeof(*walk->frames));
+    }
+    frame = &walk->frames[walk->depth++];
+    memset(frame, 0, sizeof(*frame));
+    frame->obj = obj;
+
+    return frame;
+}
+
+void
+walk_pop(walk_t *walk)
+{
+    walk->depth--;
+}
+
+void
+walk_free(walk_t *walk)
+{
+    free(walk->frames);
+    memset(walk, 0, sizeof(*walk));
+}
+
+/*
+ * Step through the implicit chain starting at *impl, descending into the
+ * children of each container in it, the way ucl_object_iterate_safe()
+ * does. Unlike that, the state lives in the caller's frame and nothing is
+ * allocated for it.
+ */
+const ucl_object_t*
+walk_iter_next(const ucl_object_t **impl, ucl_object_iter_t *expl)
+{
+    const ucl_object_t *ret;
+
+    while (*impl != NULL) {
+	if (ucl_object_type(*impl) == UCL_OBJECT ||
+	    ucl_object_type(*impl) == UCL_ARRAY) {
+	    ret = ucl_iterate_object(*impl, expl, true);
+	    if (ret != NULL) {
+		return ret;
+	    }
+	    *impl = (*impl)->next;
+	    *expl = NULL;
+	} else {
+	    ret = *impl;
+	    *impl = ret->next;
+	    return ret;
+	}
+    }
+
+    return NULL;
+}
+
+/*
+ * Drop a reference to obj without recursing once per level the way
+ * ucl_object_unref() does. Each container's children are referenced before
+ * the container itself is released, so freeing it only frees its own
+ * storage, and the children are then released in turn from a pending list.
+ * The list holds siblings as well as levels, so it is not subject to
+ * WALK_MAX_DEPTH.
+ */
+void
+walk_unref(ucl_object_t *obj)
+{
+    ucl_object_t **pending = NULL, *top;
+    ucl_object_iter_t it = NULL;
+    const ucl_object_t *cur;
+    size_t npending = 0, size = 0;
+
+    if (obj == NULL) {
+	return;
+    }
+    size = 64;
+    pending = malloc(size * sizeof(*pending));
+    pending[npending++] = obj;
+    while (npending > 0) {
+	top = pending[--npending];
+	if (top->ref == 1 && (ucl_object_type(top) == UCL_OBJECT ||
+	    ucl_object_type(top) == UCL_ARRAY)) {
+	    it = NULL;
+	    while ((cur = ucl_iterate_object(top, &it, true))) {
+		if (ucl_object_type(cur) != UCL_OBJECT &&
+		    ucl_object_type(cur) != UCL_ARRAY) {
+		    continue;
+		}
+		if (npending == size) {
+		    size *= 2;
+		    pending = realloc(pending, size * sizeof(*pending));
+		}
+		pending[npending++] = ucl_object_ref(cur);
+	    }
+	}
+	ucl_object_unref(top);
+    }
+    free(pending);
+}